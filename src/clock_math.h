@@ -0,0 +1,65 @@
+// Drift-compensated software clock math
+// Pure integer code with no Arduino dependency so the drift estimator can be exercised
+// by the host tests in test/test_clock. main.cpp owns the clock state and the raw time
+// source (clockRawUs), logging and persistence.
+#pragma once
+
+#include <stdint.h>
+
+struct SoftClock {
+  uint64_t syncRawUs;       // clockRawUs() at the last sync
+  int64_t syncEpochMs;      // UTC epoch ms at the last sync
+  uint64_t calAnchorRawUs;  // clockRawUs() at the start of the current drift measurement
+  int64_t calAnchorEpochMs; // UTC epoch ms at the start of the current drift measurement
+  int32_t driftPpb;         // Oscillator error: true elapsed = raw elapsed * (1 + driftPpb / 1e9)
+  int16_t tzOffsetMinutes;  // Local time offset from UTC
+};
+
+const uint64_t DRIFT_MIN_SAMPLE_US = 6ULL * 3600 * 1000000;   // Ignore syncs closer than 6 h for calibration
+const uint64_t DRIFT_GAIN_TIME_US = 24ULL * 3600 * 1000000;   // Longer samples get more weight
+const int32_t DRIFT_LIMIT_PPB = 500000;                       // +-500 ppm, well beyond crystal spec
+
+// Outcome of one sync, so the caller can log and persist a new drift estimate
+struct DriftSample {
+  bool measured;        // A calibration sample was taken
+  uint64_t sampleUs;    // Raw length of the sample
+  int64_t residualPpb;  // Error of the previous estimate over the sample
+};
+
+// UTC epoch ms at raw time rawUs, extrapolated from the last sync
+inline int64_t softClockNowMs(const SoftClock& clock, uint64_t rawUs) {
+  int64_t elapsedUs = (int64_t)(rawUs - clock.syncRawUs);
+  elapsedUs += elapsedUs * clock.driftPpb / 1000000000LL;
+  return clock.syncEpochMs + elapsedUs / 1000;
+}
+
+// Anchor the clock to epochMs at raw time rawUs and refine driftPpb. `synced` is false for
+// the first sync after boot, which only starts a measurement.
+inline DriftSample softClockSync(SoftClock& clock, bool synced, uint64_t rawUs, int64_t epochMs) {
+  DriftSample sample = {false, 0, 0};
+
+  if (synced) {
+    uint64_t sampleUs = rawUs - clock.calAnchorRawUs;
+    if (sampleUs >= DRIFT_MIN_SAMPLE_US) {
+      // Residual error of the current estimate over the whole sample, in ppb
+      int64_t predictedUs = (int64_t)sampleUs + (int64_t)sampleUs * clock.driftPpb / 1000000000LL;
+      int64_t actualUs = (epochMs - clock.calAnchorEpochMs) * 1000;
+      int64_t residualPpb = (actualUs - predictedUs) * 1000000000LL / (int64_t)sampleUs;
+      // Browser time is only accurate to about a second, so short samples count less
+      int64_t correctionPpb = residualPpb * (int64_t)sampleUs / (int64_t)(sampleUs + DRIFT_GAIN_TIME_US);
+      int64_t driftPpb = clock.driftPpb + correctionPpb;
+      clock.driftPpb = (int32_t)(driftPpb < -DRIFT_LIMIT_PPB ? -DRIFT_LIMIT_PPB :
+                                 driftPpb > DRIFT_LIMIT_PPB ? DRIFT_LIMIT_PPB : driftPpb);
+      clock.calAnchorRawUs = rawUs;
+      clock.calAnchorEpochMs = epochMs;
+      sample = {true, sampleUs, residualPpb};
+    }
+  } else {
+    clock.calAnchorRawUs = rawUs;
+    clock.calAnchorEpochMs = epochMs;
+  }
+
+  clock.syncRawUs = rawUs;
+  clock.syncEpochMs = epochMs;
+  return sample;
+}
@@ -4,49 +4,186 @@
 #include <ArduinoJson.h>
 #include <EEPROM.h>
 #include <ESP8266mDNS.h>
+#include <LittleFS.h>
 #include <time.h>       // For time functions
 #include <sys/time.h>   // For settimeofday
+#include <atomic>
+#include <type_traits>
+#include "clock_math.h"
+#include "soil_filter.h"
+#include "pulse_engine.h"
+#include "settings_json.h"
 extern "C" {
 #include "user_interface.h" // For WiFi sleep functions
+#include "gpio.h"           // For light sleep GPIO wakeup
 }
 
 // Pin definitions
-const int SOLENOID_1_PIN = D2;
-const int SOLENOID_2_PIN = D3;
-const int SOLENOID_3_PIN = D4;
+// Valve outputs are described at compile time (see ValveChannel below) so the
+// GPIO masks fold into constants and switching is a single register write.
+constexpr uint8_t SOLENOID_1_PIN = D2;
+constexpr uint8_t SOLENOID_2_PIN = D3;
+constexpr uint8_t SOLENOID_3_PIN = D4;
 const int BUTTON_1_PIN = D7;
 const int BUTTON_2_PIN = D6;
 
-// Button state variables
-bool button1LastState = HIGH;     // Confirmed stable state
-bool button2LastState = HIGH;     // Confirmed stable state
-bool button1PrevReading = HIGH;   // Previous raw reading
-bool button2PrevReading = HIGH;   // Previous raw reading
-unsigned long button1PressTime = 0;
-unsigned long lastDebounceTime1 = 0;
-unsigned long lastDebounceTime2 = 0;
-const unsigned long debounceDelay = 50; // ms
-bool button1LongPressDetected = false;
-
-// Solenoid state variables
-bool solenoid1Active = false;
-bool solenoid2Active = false;
-bool solenoid3Active = false;
-unsigned long solenoid1StartTime = 0;
-unsigned long solenoid2StartTime = 0;
-unsigned long solenoid3StartTime = 0;
-
-// Settings
-struct SolenoidSettings {
-  unsigned long onTime; // in minutes
-  uint8_t scheduleHour;   // 0-23
-  uint8_t scheduleMinute; // 0-59
-  bool scheduleEnabled;
+// Compile-time valve channel description
+constexpr bool isFlashPin(uint8_t gpio) { return gpio >= 6 && gpio <= 11; } // Wired to the SPI flash
+constexpr bool isUartPin(uint8_t gpio) { return gpio == 1 || gpio == 3; }   // UART0 TX/RX: Serial, log() and the console
+constexpr bool isBootStrapPin(uint8_t gpio) { return gpio == 0 || gpio == 2 || gpio == 15; }
+constexpr uint8_t bootStrapLevel(uint8_t gpio) { return gpio == 15 ? LOW : HIGH; } // Level the boot ROM needs to see
+
+constexpr const char* gpioLabel(uint8_t gpio) {
+  return gpio == D1 ? "D1" : gpio == D2 ? "D2" : gpio == D3 ? "D3" : gpio == D4 ? "D4" :
+         gpio == D5 ? "D5" : gpio == D6 ? "D6" : gpio == D7 ? "D7" : gpio == D8 ? "D8" : "GPIO?";
+}
+
+// One valve output. StrapAck must be set explicitly when a valve sits on a boot-strap pin
+// with an active level equal to the level the boot ROM needs, because the valve will then
+// energise briefly while the chip resets (the stock D3/D4 wiring does exactly that).
+template <uint8_t Pin, uint8_t ActiveLevel, bool StrapAck = false>
+struct ValveChannel {
+  static_assert(Pin < 16, "GPIO16 lives in the RTC block and cannot be driven through GPOS/GPOC");
+  static_assert(!isFlashPin(Pin), "GPIO6-11 are reserved for the SPI flash");
+  static_assert(!isUartPin(Pin), "GPIO1/GPIO3 are UART0 TX/RX, used by Serial and as the console wake source");
+  static_assert(ActiveLevel == HIGH || ActiveLevel == LOW, "ActiveLevel must be HIGH or LOW");
+  static_assert(!isBootStrapPin(Pin) || ActiveLevel != bootStrapLevel(Pin) || StrapAck,
+                "Valve on a boot-strap pin would be energised during reset; invert it or set StrapAck");
+
+  static constexpr uint8_t pin = Pin;
+  static constexpr uint32_t mask = 1UL << Pin;
+  static constexpr uint32_t onSetMask = ActiveLevel == HIGH ? mask : 0;   // Bits for GPOS when switching on
+  static constexpr uint32_t onClearMask = ActiveLevel == HIGH ? 0 : mask; // Bits for GPOC when switching on
+  static constexpr const char* label = gpioLabel(Pin);
+};
+
+// A fixed set of valve channels. Channel i corresponds to bit i of a channel mask,
+// so any combination of valves is switched with at most one GPOS and one GPOC write.
+template <typename... Channels>
+struct ValveBank {
+  static constexpr uint8_t count = sizeof...(Channels);
+  static_assert(count > 0 && count <= 8, "ValveBank supports 1-8 channels");
+
+  static constexpr uint8_t pins[count] = {Channels::pin...};
+  static constexpr uint32_t onSet[count] = {Channels::onSetMask...};
+  static constexpr uint32_t onClear[count] = {Channels::onClearMask...};
+  static constexpr const char* labels[count] = {Channels::label...};
+  static constexpr uint32_t allPins = (Channels::mask | ...);
+
+  static_assert(__builtin_popcount(allPins) == count, "Two valve channels share the same GPIO");
+
+  static void begin() {
+    switchOff((1U << count) - 1);
+    for (uint8_t i = 0; i < count; ++i) {
+      pinMode(pins[i], OUTPUT);
+    }
+  }
+
+  // Energise every channel whose bit is set in channelMask in the same cycle
+  static inline void switchOn(uint8_t channelMask) { write(channelMask, onSet, onClear); }
+  // De-energise every channel whose bit is set in channelMask in the same cycle
+  static inline void switchOff(uint8_t channelMask) { write(channelMask, onClear, onSet); }
+
+ private:
+  static inline void write(uint8_t channelMask, const uint32_t* setBits, const uint32_t* clearBits) {
+    uint32_t set = 0;
+    uint32_t clear = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+      if (channelMask & (1U << i)) {
+        set |= setBits[i];
+        clear |= clearBits[i];
+      }
+    }
+    if (set) GPOS = set;
+    if (clear) GPOC = clear;
+  }
+};
+
+// The MOSFET gates are active HIGH. D3/D4 are GPIO0/GPIO2 which are pulled up at boot,
+// so valves 2 and 3 can twitch during reset; acknowledged to keep the existing wiring.
+using Valves = ValveBank<
+  ValveChannel<SOLENOID_1_PIN, HIGH>,
+  ValveChannel<SOLENOID_2_PIN, HIGH, true>,
+  ValveChannel<SOLENOID_3_PIN, HIGH, true>
+>;
+
+// Button event engine
+// Edge interrupts timestamp every transition into a lock-free queue; handleButtons()
+// debounces the queued edges and turns them into gestures that dispatch configurable actions.
+enum ButtonGesture : uint8_t {
+  GESTURE_CLICK,
+  GESTURE_DOUBLE_CLICK,
+  GESTURE_LONG_PRESS,
+  GESTURE_HOLD_REPEAT,
+  GESTURE_COUNT
+};
+const char* const GESTURE_NAMES[GESTURE_COUNT] = {"Click", "Double click", "Long press", "Hold repeat"};
+
+constexpr uint8_t BUTTON_COUNT = 2;
+constexpr uint8_t BUTTON_PINS[BUTTON_COUNT] = {BUTTON_1_PIN, BUTTON_2_PIN};
+const char* const BUTTON_NAMES[BUTTON_COUNT] = {"Button 1 (D7)", "Button 2 (D6)"};
+
+const unsigned long debounceDelay = 50;           // ms
+const unsigned long LONG_PRESS_TIME = 5000;       // ms
+const unsigned long DOUBLE_CLICK_WINDOW = 400;    // ms between release and next press
+const unsigned long HOLD_REPEAT_INTERVAL = 1000;  // ms between repeats after a long press
+const unsigned long CHORD_WINDOW = 150;           // ms between both presses to count as a chord
+
+struct ButtonEdge {
+  uint32_t timeUs;
+  uint8_t button;
+  uint8_t level;
+};
+
+// Single-producer queue: all GPIO interrupts are dispatched from one non-nesting handler
+constexpr uint8_t BUTTON_QUEUE_SIZE = 32; // Power of two
+ButtonEdge buttonEdgeQueue[BUTTON_QUEUE_SIZE];
+std::atomic<uint8_t> buttonEdgeHead(0);
+std::atomic<uint8_t> buttonEdgeTail(0);
+volatile bool buttonEdgeOverflow = false;
+
+struct ButtonState {
+  bool rawLevel;           // Level of the most recent edge
+  bool pressed;            // Debounced state
+  uint32_t lastEdgeUs;     // Time of the most recent edge
+  uint32_t pressUs;        // Time the current/last press started
+  uint32_t releaseUs;      // Time the last press ended
+  uint32_t nextRepeatUs;   // Next hold-repeat deadline
+  bool longFired;
+  bool clickPending;       // Waiting to see whether a double click follows
+  bool chorded;            // Press was consumed by a two-button chord
 };
+ButtonState buttons[BUTTON_COUNT] = {{HIGH, false, 0, 0, 0, 0, false, false, false},
+                                     {HIGH, false, 0, 0, 0, 0, false, false, false}};
 
+typedef void (*ButtonAction)(uint8_t button);
+
+// Press-to-action latency, measured from the edge timestamp that completed the gesture
+struct ButtonLatencyStats {
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint32_t count;
+  uint64_t totalUs;
+};
+ButtonLatencyStats buttonLatency = {0, 0, 0, 0};
+
+// Solenoid state variables (index 0 = Solenoid 1), maintained by activateSolenoid()/deactivateSolenoid()
+constexpr uint8_t SOLENOID_COUNT = Valves::count;
+bool solenoidActive[SOLENOID_COUNT] = {false, false, false};
+unsigned long solenoidStartTime[SOLENOID_COUNT] = {0, 0, 0};
+unsigned long solenoidDurationMs[SOLENOID_COUNT] = {0, 0, 0}; // Run time of the current activation
+
+// What opened a valve, for the usage history
+enum ActivationSource : uint8_t { SOURCE_BUTTON, SOURCE_SCHEDULE, SOURCE_WEB, SOURCE_CONSOLE, SOURCE_COUNT };
+const char* const SOURCE_NAMES[SOURCE_COUNT] = {"button", "schedule", "web", "console"};
+ActivationSource solenoidSource[SOLENOID_COUNT] = {SOURCE_BUTTON, SOURCE_BUTTON, SOURCE_BUTTON};
+bool solenoidCountsActivation[SOLENOID_COUNT]; // False for the later pulses of a pulse program
+
+// Settings (SolenoidSettings and the JSON mapping are in settings_json.h)
 SolenoidSettings solenoid1Settings = {1, 12, 0, false}; // Default: 1 min, 12:00, disabled
 SolenoidSettings solenoid2Settings = {1, 12, 0, false};
 SolenoidSettings solenoid3Settings = {1, 12, 0, false};
+SolenoidSettings* const solenoidSettings[SOLENOID_COUNT] = {&solenoid1Settings, &solenoid2Settings, &solenoid3Settings};
 
 // WiFi and webserver
 const char* ssid = "SolenoidController";
@@ -57,12 +194,301 @@ unsigned long wifiStartTime = 0;
 const unsigned long WIFI_AUTO_OFF_TIME = 20 * 60 * 1000; // 20 minutes in milliseconds
 
 // Timekeeping
-time_t now;
+// The controller is AP-only, so time comes from the browser via /settime. Between syncs a
+// software clock extrapolates from the last sync using clockRawUs() scaled by the measured
+// oscillator drift, and local time is derived from a configurable UTC offset.
+time_t now;             // Local time (UTC + tzOffsetMinutes), broken down with gmtime_r
 struct tm timeinfo;
 bool time_synced = false;
+
+SoftClock softClock = {0, 0, 0, 0, 0, 2 * 60}; // Default: UTC+2 (Berlin summer time), see clock_math.h
 int last_run_day[3] = {-1, -1, -1}; // Tracks day of year for last schedule run (0=S1, 1=S2, 2=S3)
 
 
+// Bulk calendar
+// Uploaded events are stored per channel in LittleFS: a header, the events sorted by start
+// time, then a block index (first start time of every block) that is kept in RAM so the
+// next event is found by binary search over the index and then within one block.
+struct CalendarEvent {
+  uint32_t startLocal;  // Local time in seconds since 1970, same scale as `now`
+  uint16_t durationMin;
+  uint16_t reserved;
+};
+
+struct CalendarFileHeader {
+  uint32_t magic;
+  uint32_t count;
+  uint32_t blockCount;
+};
+
+const uint32_t CALENDAR_MAGIC_NUMBER = 0xCA1E0001;
+constexpr uint16_t CALENDAR_BLOCK_EVENTS = 256;
+constexpr uint16_t CALENDAR_MAX_BLOCKS = 64;  // 16384 events per channel
+const uint32_t CALENDAR_TRIGGER_WINDOW = 120; // Seconds, same 2-minute window as daily schedules
+
+struct CalendarChannel {
+  uint32_t count;
+  uint16_t blockCount;
+  uint32_t blockStart[CALENDAR_MAX_BLOCKS];
+  CalendarEvent next; // Cached next pending event
+  bool nextValid;
+  bool exhausted;     // No events left after `now`; cleared when time or calendar changes
+};
+CalendarChannel calendars[SOLENOID_COUNT];
+
+// State of an in-progress upload; only allocated while a request is streaming
+struct CalendarUpload {
+  File files[SOLENOID_COUNT];
+  CalendarChannel built[SOLENOID_COUNT];
+  char line[64];
+  uint8_t lineLen;
+  uint8_t record[sizeof(CalendarEvent)];
+  uint8_t recordLen;
+  bool binary;
+  uint32_t lineNumber;
+  uint32_t bytes;
+  unsigned long startMs;
+  String error;
+};
+CalendarUpload* calendarUpload = nullptr;
+bool calendarUploadActive = false; // Between UPLOAD_FILE_START and END/ABORTED; holds the governor in performance
+
+struct CalendarUploadStats {
+  uint32_t events;
+  uint32_t bytes;
+  unsigned long durationMs;
+};
+CalendarUploadStats calendarLastUpload = {0, 0, 0};
+
+// Sampling profiler
+// Timer1 interrupts record the interrupted PC (EPC1) into a fixed open-addressing histogram.
+// Off by default: while stopped the timer is disabled, so the only cost is the table's RAM.
+// Code running with interrupts masked (SDK critical sections, flash writes) cannot be sampled.
+constexpr uint8_t PROFILER_BUCKET_BITS = 8;
+constexpr uint16_t PROFILER_BUCKETS = 1U << PROFILER_BUCKET_BITS;
+constexpr uint8_t PROFILER_MAX_PROBES = 8;
+struct ProfilerBucket {
+  uint32_t pc;
+  uint32_t count;
+};
+ProfilerBucket profilerHistogram[PROFILER_BUCKETS];
+volatile uint32_t profilerSamples = 0;
+volatile uint32_t profilerDropped = 0; // Samples whose PC found no free bucket
+bool profilerRunning = false;
+uint32_t profilerHz = 0;
+
+// Soil moisture
+// A0 is sampled in the background: SOIL_OVERSAMPLE paced reads are summed and decimated to
+// a 12-bit value, a running median rejects spikes, and hysteresis thresholds classify the
+// soil as wet. Scheduled (not manual) activations are skipped or shortened accordingly.
+// Reads are spaced SOIL_ADC_INTERVAL apart because back-to-back ADC reads disturb WiFi.
+constexpr uint8_t SOIL_MUX_PIN_COUNT = 0;              // Select lines of an optional analog multiplexer
+constexpr uint8_t SOIL_MUX_PINS[2] = {D1, D5};         // Only the first SOIL_MUX_PIN_COUNT are driven
+constexpr uint8_t SOIL_SENSOR_COUNT = 1U << SOIL_MUX_PIN_COUNT;
+constexpr int8_t SOIL_SENSOR_FOR_CHANNEL[3] = {0, 0, 0}; // Sensor per valve, -1 = none
+static_assert(SOIL_MUX_PIN_COUNT <= sizeof(SOIL_MUX_PINS), "Not enough multiplexer select pins");
+
+const unsigned long SOIL_ADC_INTERVAL = 20;   // ms between ADC reads; filter stages are in soil_filter.h
+
+SoilSettings soilSettings = {false, 800, 400, 60, 50, 30}; // Typical capacitive sensor, disabled
+SoilFilter soilFilters[SOIL_SENSOR_COUNT];
+uint8_t soilCurrentSensor = 0;
+bool soilSettling = false;              // Discard the first read after switching the multiplexer
+
+enum SoilDecision : uint8_t { SOIL_RUN, SOIL_SHORTENED, SOIL_SKIPPED, SOIL_NO_DATA };
+const char* const SOIL_DECISION_NAMES[] = {"run", "shortened", "skipped", "noData"};
+struct SoilDecisionRecord {
+  time_t time;      // Local time of the decision, 0 = none yet
+  uint8_t percent;
+  SoilDecision decision;
+  uint16_t minutes; // Minutes actually scheduled
+};
+SoilDecisionRecord soilLastDecision[3];
+
+// Pulse programs (cycle and soak): the engine and its state are in pulse_engine.h
+static_assert(PULSE_CHANNELS == SOLENOID_COUNT, "One pulse program per valve");
+
+// Configuration snapshots
+// Little-endian binary: "WCS1", uint16 version, uint16 payload length, then records of
+// uint8 field id, uint8 size and the value, then the zlib CRC-32 of everything before it.
+// Unknown ids are skipped and missing ones left unchanged, so new fields only need a new
+// id; the version changes only if an existing field changes meaning. tools/snapshot.py
+// knows the same ids.
+const uint16_t SNAPSHOT_VERSION = 1;
+constexpr size_t SNAPSHOT_MAX_SIZE = 256;
+struct SnapshotUpload {
+  uint8_t data[SNAPSHOT_MAX_SIZE];
+  size_t length;
+  bool overflow;
+};
+SnapshotUpload* snapshotUpload = nullptr; // Only allocated while an upload is in progress
+
+// Usage history
+// Round-robin tiers of minutes open and activation counts per valve, bucketed by local
+// time. deactivateSolenoid() adds each run, split across bucket boundaries, so no raw
+// events are kept. The tiers live in RAM and are checkpointed to LittleFS every few hours;
+// a power cut loses at most USAGE_CHECKPOINT_INTERVAL_US of history.
+constexpr uint8_t USAGE_HOURS = 48;
+constexpr uint8_t USAGE_DAYS = 31;
+constexpr uint8_t USAGE_WEEKS = 52;
+const uint64_t USAGE_CHECKPOINT_INTERVAL_US = 6ULL * 3600 * 1000000; // Between flash writes, on clockRawUs() so light sleep counts
+const uint32_t USAGE_MAGIC_NUMBER = 0x05A6E001;
+const char* const USAGE_PATH = "/usage.bin";
+
+struct UsageBucket {
+  uint32_t openSeconds;
+  uint8_t activations[SOURCE_COUNT]; // Saturating
+};
+struct UsageTierInfo {
+  const char* name;
+  uint32_t bucketSeconds;
+  uint8_t bucketCount;
+  uint32_t alignSeconds; // Added before dividing; aligns weeks to Monday
+};
+enum UsageTier : uint8_t { USAGE_HOURLY, USAGE_DAILY, USAGE_WEEKLY, USAGE_TIER_COUNT };
+const UsageTierInfo USAGE_TIERS[USAGE_TIER_COUNT] = {
+  {"hourly", 3600,       USAGE_HOURS, 0},
+  {"daily",  86400,      USAGE_DAYS,  0},
+  {"weekly", 7 * 86400,  USAGE_WEEKS, 3 * 86400}, // 1970-01-01 was a Thursday
+};
+struct UsageHistory {
+  uint32_t magic;
+  uint32_t newestIndex[USAGE_TIER_COUNT]; // Bucket number since 1970 of each tier's newest bucket
+  UsageBucket hourly[3][USAGE_HOURS];
+  UsageBucket daily[3][USAGE_DAYS];
+  UsageBucket weekly[3][USAGE_WEEKS];
+};
+UsageHistory usageHistory;
+bool usageDirty = false;
+uint64_t usageLastCheckpointUs = 0;
+uint32_t usageUnplacedSeconds[3] = {0, 0, 0}; // Open time before the clock was first synced
+
+// Web UI caching and time-to-interactive
+// The page shell is static; UI_BUILD_ID, a hash of its content, versions it (see handleRoot())
+struct UiTimingStats {
+  uint32_t count;
+  uint32_t cachedCount;  // Shell came from the browser cache or the service worker
+  uint32_t lastMs;
+  uint32_t bestMs;
+  uint32_t worstMs;
+  uint32_t totalMs;
+};
+UiTimingStats uiTiming = {0, 0, 0, UINT32_MAX, 0, 0};
+
+// Serial console
+// Lines are collected from the UART a few bytes at a time by the console task and parsed
+// in place, so a command never blocks the loop or allocates. Replies are queued and fed to
+// the UART FIFO as it empties, also by the console task. Replies start with "ok" or
+// "error:" so host scripts can drive it. While the chip is in light sleep the UART is
+// not clocked: the falling edge of the first byte wakes it but that byte is lost.
+constexpr uint8_t CONSOLE_LINE_MAX = 96;
+constexpr uint8_t CONSOLE_BYTES_PER_RUN = 32;  // Bounded work per task run
+constexpr uint16_t CONSOLE_OUT_SIZE = 1536;    // Reply queue; `metrics` and `get` are about 1 KB
+constexpr uint8_t CONSOLE_UART_FIFO = 128;     // Bytes the UART TX FIFO holds
+const uint8_t CONSOLE_RX_PIN = 3;              // GPIO3, UART0 RX
+char consoleLine[CONSOLE_LINE_MAX];
+uint8_t consoleLength = 0;
+bool consoleOverflow = false;
+unsigned long lastConsoleActivity = 0;
+
+// Reply queue. A blocking Serial.printf of a 1 KB reply would stall the loop for about
+// 90 ms at 115200 baud; instead drain() moves only what the FIFO has room for, in whole
+// lines where possible so a log() line written in between does not split a reply.
+struct ConsoleOutput : public Print {
+  char ring[CONSOLE_OUT_SIZE];
+  uint16_t head = 0;    // Oldest queued byte
+  uint16_t count = 0;
+  uint32_t dropped = 0; // Bytes lost to a full queue, reported once it drains
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* data, size_t len) override {
+    size_t room = CONSOLE_OUT_SIZE - count;
+    size_t n = len < room ? len : room;
+    for (size_t i = 0; i < n; ++i) {
+      ring[(head + count + i) % CONSOLE_OUT_SIZE] = data[i];
+    }
+    count += n;
+    dropped += len - n;
+    return len;
+  }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    static char line[160];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (n < 0) {
+      return 0;
+    }
+    return write((const uint8_t*)line, n < (int)sizeof(line) ? n : sizeof(line) - 1);
+  }
+  void drain() {
+    size_t room = Serial.availableForWrite();
+    size_t n = count < room ? count : room;
+    if (n < count) {
+      size_t lineEnd = n;
+      while (lineEnd > 0 && ring[(head + lineEnd - 1) % CONSOLE_OUT_SIZE] != '\n') {
+        --lineEnd;
+      }
+      // A line longer than the free space goes out once the FIFO is empty
+      n = lineEnd > 0 || room < CONSOLE_UART_FIFO ? lineEnd : n;
+    }
+    while (n > 0) {
+      size_t chunk = head + n <= CONSOLE_OUT_SIZE ? n : CONSOLE_OUT_SIZE - head;
+      Serial.write((const uint8_t*)ring + head, chunk);
+      head = (head + chunk) % CONSOLE_OUT_SIZE;
+      count -= chunk;
+      n -= chunk;
+    }
+    if (count == 0 && dropped) {
+      printf("error: console output full, %u bytes dropped\r\n", dropped);
+      dropped = 0;
+    }
+  }
+};
+ConsoleOutput consoleOut;
+
+// bench results; `bench tick` is measured from loop() over the next passes, outside any task
+struct ConsoleBench {
+  const char* what;
+  uint32_t iterations;
+  uint32_t remaining;  // Passes still to time for `bench tick`
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  size_t bytes;        // Serialized size for `bench json`
+};
+ConsoleBench consoleBenchRun = {nullptr, 0, 0, 0, 0, 0, 0};
+
+// Power governor
+// Picks a power state from the current workload once per loop() pass and paces the loop
+// accordingly. In AP mode the SDK cannot modem-sleep, so "modem sleep" here is the radio
+// held in forced sleep after the AP shut down while a valve or button still needs the CPU.
+enum GovernorState : uint8_t {
+  GOV_PERFORMANCE,  // 160 MHz: HTTP traffic or upload in progress
+  GOV_IDLE_AP,      // 80 MHz: AP up, no recent requests
+  GOV_MODEM_SLEEP,  // 80 MHz: radio off, valve running or button gesture in progress
+  GOV_LIGHT_SLEEP,  // Radio off and nothing to do: timed light sleep, woken early by a button
+  GOV_STATE_COUNT
+};
+const char* const GOVERNOR_STATE_NAMES[GOV_STATE_COUNT] = {"performance", "idleAp", "modemSleep", "lightSleep"};
+
+const unsigned long GOV_ACTIVITY_HOLD_TIME = 3000; // ms at 160 MHz after the last HTTP request
+const unsigned long GOV_IDLE_AP_DELAY = 5;         // ms the loop idles per pass with the AP up
+const unsigned long GOV_MODEM_SLEEP_DELAY = 10;    // ms the loop idles per pass with the radio off
+const uint32_t GOV_LIGHT_SLEEP_MAX = 30000;        // ms; well inside the 2-minute schedule window
+
+GovernorState governorState = GOV_PERFORMANCE;
+unsigned long lastHttpActivity = 0;
+uint64_t governorSleptUs = 0;                      // Total time spent in forced light sleep
+uint64_t governorResidencyUs[GOV_STATE_COUNT] = {0, 0, 0, 0};
+uint64_t governorLastUpdateUs = 0;
+uint32_t governorLightSleeps = 0;
+uint32_t governorButtonWakeups = 0;
+uint32_t governorSleepFailures = 0; // wifi_fpm_do_sleep() refused; the pass fell back to a short idle
+uint64_t governorIdleUs = 0;           // Time spent in the governor's idle delays and sleeps
+volatile bool governorWoke = false;
+
 // EEPROM addresses
 const int EEPROM_SIZE = 512;
 const int EEPROM_MAGIC_NUMBER_ADDR = 0; // uint32_t (4 bytes)
@@ -84,6 +510,116 @@ const int EEPROM_SOLENOID3_SCHED_ENABLED_ADDR = EEPROM_SOLENOID3_SCHED_MIN_ADDR
 
 const uint32_t EEPROM_MAGIC_NUMBER = 0xA1B2C3D5; // Updated magic number for new structure
 
+// Clock calibration block, validated by its own magic so existing valve settings survive upgrades
+const int EEPROM_CLOCK_MAGIC_ADDR = EEPROM_SOLENOID3_SCHED_ENABLED_ADDR + sizeof(uint8_t); // uint32_t (4 bytes)
+const int EEPROM_CLOCK_DRIFT_ADDR = EEPROM_CLOCK_MAGIC_ADDR + sizeof(uint32_t);            // int32_t (4 bytes, ppb)
+const int EEPROM_CLOCK_TZ_ADDR = EEPROM_CLOCK_DRIFT_ADDR + sizeof(int32_t);                // int16_t (2 bytes, minutes)
+
+// Soil sensor block, validated by its own magic
+const int EEPROM_SOIL_MAGIC_ADDR = EEPROM_CLOCK_TZ_ADDR + sizeof(int16_t);     // uint32_t (4 bytes)
+const int EEPROM_SOIL_SETTINGS_ADDR = EEPROM_SOIL_MAGIC_ADDR + sizeof(uint32_t); // SoilSettings
+
+// Pulse program block, validated by its own magic
+const int EEPROM_PULSE_MAGIC_ADDR = EEPROM_SOIL_SETTINGS_ADDR + sizeof(SoilSettings);  // uint32_t (4 bytes)
+const int EEPROM_PULSE_SETTINGS_ADDR = EEPROM_PULSE_MAGIC_ADDR + sizeof(uint32_t);      // PulseSettings[3]
+
+const uint32_t EEPROM_CLOCK_MAGIC_NUMBER = 0xC10C0001;
+const uint32_t EEPROM_SOIL_MAGIC_NUMBER = 0x50110001;
+const uint32_t EEPROM_PULSE_MAGIC_NUMBER = 0x9015E001;
+
+
+// Event tracing
+// Fixed-size binary begin/end/instant records with microsecond timestamps go into a
+// preallocated ring buffer. GET /trace dumps it; tools/trace_to_chrome.py converts the
+// dump to Chrome trace JSON for Perfetto. Safe to call from interrupts.
+enum TraceId : uint8_t {
+  TRACE_HANDLE_BUTTONS,
+  TRACE_CHECK_SCHEDULES,
+  TRACE_BUTTON_EDGE,      // Instant, arg = button | level << 8 (ISR)
+  TRACE_BUTTON_GESTURE,   // Instant, arg = button | gesture << 8
+  TRACE_SOLENOID_ON,      // Instant, arg = solenoid number
+  TRACE_SOLENOID_OFF,     // Instant, arg = solenoid number
+  TRACE_EEPROM_COMMIT,
+  TRACE_AP_START,
+  TRACE_AP_SHUTDOWN,
+  TRACE_STATION_JOIN,     // Instant, arg = association id
+  TRACE_STATION_LEAVE,    // Instant, arg = association id
+  TRACE_LIGHT_SLEEP,
+  TRACE_GOVERNOR_STATE,   // Instant, arg = new GovernorState
+  TRACE_HTTP_ROOT,
+  TRACE_HTTP_GET_SETTINGS,
+  TRACE_HTTP_POST_SETTINGS,
+  TRACE_HTTP_SETTIME,
+  TRACE_HTTP_ACTIVATE,    // arg = solenoid number
+  TRACE_HTTP_CALENDAR_CHUNK,
+  TRACE_HTTP_CALENDAR_DONE,
+  TRACE_HTTP_GET_CALENDAR,
+  TRACE_HTTP_PROFILE,
+  TRACE_HTTP_POWER,
+  TRACE_SOIL_DECISION,    // Instant, arg = channel | SoilDecision << 8
+  TRACE_HTTP_SOIL,
+  TRACE_HTTP_TASKS,
+  TRACE_DEADLINE_MISS,    // Instant, arg = task index
+  TRACE_HTTP_BOOTSTRAP,
+  TRACE_HTTP_UI_TIMING,
+  TRACE_CONSOLE_COMMAND,  // arg = command index
+  TRACE_PULSE_PHASE,      // Instant, arg = channel | PulsePhase << 8
+  TRACE_HTTP_PULSE,
+  TRACE_HTTP_GET_SNAPSHOT,
+  TRACE_HTTP_POST_SNAPSHOT,
+  TRACE_HTTP_HISTORY,
+  TRACE_USAGE_CHECKPOINT,
+  TRACE_ID_COUNT
+};
+const char* const TRACE_NAMES[TRACE_ID_COUNT] = {
+  "handleButtons", "checkScheduledEvents", "buttonEdge", "buttonGesture", "solenoidOn", "solenoidOff",
+  "eepromCommit", "apStart", "apShutdown", "stationJoin", "stationLeave", "lightSleep", "governorState",
+  "GET /", "GET /settings", "POST /settings", "POST /settime", "POST /activateSolenoid", "calendar chunk",
+  "POST /calendar", "GET /calendar", "GET /profile", "GET /power", "soilDecision", "GET /soil",
+  "GET /tasks", "deadlineMiss", "GET /api/bootstrap", "/api/tti", "console", "pulsePhase", "/pulse",
+  "GET /snapshot", "POST /snapshot", "GET /history", "usageCheckpoint"
+};
+
+enum TracePhase : uint8_t { TRACE_BEGIN = 'B', TRACE_END = 'E', TRACE_INSTANT = 'i' };
+constexpr uint8_t TRACE_FROM_ISR = 0x80; // OR-ed into the phase of records written by interrupts
+
+struct TraceRecord {
+  uint32_t timeUs;
+  uint8_t phase;
+  uint8_t id;
+  uint16_t arg;
+};
+static_assert(sizeof(TraceRecord) == 8, "Trace records are dumped as packed 8-byte records");
+
+constexpr uint16_t TRACE_BUFFER_SIZE = 512; // Power of two
+TraceRecord traceBuffer[TRACE_BUFFER_SIZE];
+uint16_t traceHead = 0;
+uint16_t traceCount = 0;
+volatile bool traceEnabled = true;
+
+IRAM_ATTR void traceRecord(uint8_t phase, TraceId id, uint16_t arg = 0) {
+  if (!traceEnabled) {
+    return;
+  }
+  uint32_t savedPs = xt_rsil(15); // Interrupts may record too
+  traceBuffer[traceHead] = TraceRecord{(uint32_t)micros(), phase, id, arg};
+  traceHead = (traceHead + 1) & (TRACE_BUFFER_SIZE - 1);
+  if (traceCount < TRACE_BUFFER_SIZE) {
+    traceCount++;
+  }
+  xt_wsr_ps(savedPs);
+}
+
+// Records a begin event now and the matching end event when it goes out of scope
+struct TraceScope {
+  TraceId id;
+  uint16_t arg;
+  TraceScope(TraceId traceId, uint16_t traceArg = 0) : id(traceId), arg(traceArg) { traceRecord(TRACE_BEGIN, id, arg); }
+  ~TraceScope() { traceRecord(TRACE_END, id, arg); }
+};
+
+WiFiEventHandler stationConnectedHandler;
+WiFiEventHandler stationDisconnectedHandler;
 
 // Function prototypes
 void handleRoot();
@@ -92,103 +628,304 @@ void handleUpdateSettings();
 void handleActivateSolenoid1();
 void handleActivateSolenoid2();
 void handleActivateSolenoid3();
-void activateSolenoid(int solenoidNum, unsigned long duration);
+void activateSolenoid(int solenoidNum, unsigned long duration, ActivationSource source);
 void deactivateSolenoid(int solenoidNum);
+void activateSolenoids(uint8_t channelMask, ActivationSource source);
+void markSolenoidOn(int solenoidNum, unsigned long durationMs, ActivationSource source);
 void loadSettings();
 void saveSettings();
 void handleButtons();
+void setupButtons();
+void queueButtonEdge(uint8_t button);
+bool buttonsIdle();
+void actionStartSolenoids12(uint8_t button);
+void actionStartSolenoid3(uint8_t button);
+void actionEnsureAccessPoint(uint8_t button);
+void actionStopAllSolenoids(uint8_t button);
 void setupAccessPoint();
 void shutdownWiFiCompletely(); // Function to properly shut down WiFi for power saving
 void log(String message);
 void handleSetTime(); // New handler for time synchronization
+int64_t clockNowMs();
+void clockUpdateLocalTime();
+void clockSync(int64_t epochMs);
 void checkScheduledEvents(); // New function for schedule logic
+void calendarBegin();
+void calendarCheck(uint8_t channel);
+void calendarInvalidateCursors();
+void handleCalendarUpload();
+void handleCalendarUploadDone();
+void handleGetCalendar();
+void profilerStart(uint32_t hz);
+void profilerStop();
+void handleProfile();
+uint64_t clockRawUs();
+void governorUpdate();
+void handlePower();
+void handleTrace();
+void soilBegin();
+void soilSample();
+void activateScheduledSolenoid(uint8_t channel, unsigned long durationMs);
+void handleSoil();
+void taskValves();
+void taskNetwork();
+void schedulerTick();
+void handleTasks();
+void settingsToJson(JsonObject doc);
+void clockSetTimezone(int tzOffsetMinutes);
+void handleBootstrap();
+void handleServiceWorker();
+void handleUiTiming();
+void consoleTask();
+void pulseToJson(uint8_t channel, JsonObject doc);
+void handleGetPulse();
+void handlePostPulse();
+void handleGetSnapshot();
+void handleSnapshotUpload();
+void handleSnapshotUploadDone();
+void usageBegin();
+void usageRecord(uint8_t channel, uint32_t startLocal, uint32_t seconds, ActivationSource source, bool activation);
+void usageTask();
+void handleHistory();
 String padZero(int number); // Helper function to pad numbers with leading zero
 
+// Gesture -> action table. nullptr means the gesture is ignored; a button without a
+// double-click action fires its click immediately on release instead of waiting.
+ButtonAction buttonActions[BUTTON_COUNT][GESTURE_COUNT] = {
+  // Click                   Double click  Long press                Hold repeat
+  {actionStartSolenoids12,   nullptr,      actionEnsureAccessPoint,  nullptr},
+  {actionStartSolenoid3,     nullptr,      nullptr,                  nullptr},
+};
+ButtonAction chordAction = actionStopAllSolenoids; // Both buttons pressed together
+
+// Cooperative scheduler
+// loop() walks the task table in order, which is also the priority order. Tasks run to
+// completion; the critical ones are polled again before every other task, so a slow HTTP
+// handler delays turning a valve off by at most its own run time. A task's deadline is the
+// longest acceptable time from release to completion: for period 0 tasks the release is
+// the end of its previous run, for periodic tasks the scheduled release time.
+typedef void (*TaskFunction)();
+struct Task {
+  const char* name;
+  TaskFunction run;
+  uint32_t periodMs;   // 0 = every pass
+  uint32_t deadlineUs; // 0 = no deadline
+  bool critical;
+};
+const Task TASKS[] = {
+  {"valves",       taskValves,           0,                 50000,  true},
+  {"input",        handleButtons,        0,                 50000,  true},
+  {"soil",         soilSample,           SOIL_ADC_INTERVAL, 20000,  false},
+  {"schedule",     checkScheduledEvents, 100,               250000, false},
+  {"console",      consoleTask,          10,                0,      false},
+  {"network",      taskNetwork,          0,                 0,      false}, // HTTP handlers vary too much
+  {"usage",        usageTask,            60000,             0,      false}, // Flash writes take a while
+  {"housekeeping", governorUpdate,       0,                 0,      false}, // Idles; always last
+};
+constexpr uint8_t TASK_COUNT = sizeof(TASKS) / sizeof(TASKS[0]);
+
+struct TaskStats {
+  uint32_t releaseUs;  // micros() of the current release
+  uint32_t runs;
+  uint32_t misses;
+  uint32_t maxUs;      // Longest single run, idle excluded
+  uint32_t maxLatencyUs;
+  uint64_t totalUs;    // CPU time, idle excluded
+};
+TaskStats taskStats[TASK_COUNT];
+uint64_t schedulerStartUs = 0;
+
 void setup() {
   Serial.begin(115200);
   Serial.println("\n\nSolenoid Controller starting...");
   
-  pinMode(SOLENOID_1_PIN, OUTPUT);
-  pinMode(SOLENOID_2_PIN, OUTPUT);
-  pinMode(SOLENOID_3_PIN, OUTPUT);
-  pinMode(BUTTON_1_PIN, INPUT_PULLUP);
-  pinMode(BUTTON_2_PIN, INPUT_PULLUP);
-  
-  digitalWrite(SOLENOID_1_PIN, LOW);
-  digitalWrite(SOLENOID_2_PIN, LOW);
-  digitalWrite(SOLENOID_3_PIN, LOW);
+  Valves::begin(); // Latch all valves off before enabling the output drivers
+  setupButtons();
   
   EEPROM.begin(EEPROM_SIZE);
   loadSettings();
+  calendarBegin();
+  usageBegin();
+  soilBegin();
+
+  uint32_t startUs = micros();
+  for (uint8_t i = 0; i < TASK_COUNT; ++i) {
+    taskStats[i].releaseUs = startUs;
+  }
+  schedulerStartUs = clockRawUs();
+
+  stationConnectedHandler = WiFi.onSoftAPModeStationConnected([](const WiFiEventSoftAPModeStationConnected& event) {
+    traceRecord(TRACE_INSTANT, TRACE_STATION_JOIN, event.aid);
+  });
+  stationDisconnectedHandler = WiFi.onSoftAPModeStationDisconnected([](const WiFiEventSoftAPModeStationDisconnected& event) {
+    traceRecord(TRACE_INSTANT, TRACE_STATION_LEAVE, event.aid);
+  });
 
   for (int i = 0; i < 3; ++i) {
     last_run_day[i] = -1; // Initialize last run day to ensure first schedule runs
   }
   
-  // Configure NTP with timezone support
-  configTime(2 * 3600, 0, "pool.ntp.org", "time.google.com"); // UTC+2 (Berlin timezone)
-  
-  // Wait for NTP sync
-  Serial.println("Waiting for NTP time sync...");
-  unsigned long ntpTimeout = millis() + 2000; // 10 second timeout
-  while (time(nullptr) < 1000000000 && millis() < ntpTimeout) { // Wait until we have a reasonable timestamp
-    delay(100);
-  }
-  
-  if (time(nullptr) >= 1000000000) {
-    time_synced = true;
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    char timeStr[64];
-    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", &timeinfo);
-    log("NTP time synchronized: " + String(timeStr));
-  } else {
-    log("NTP sync failed, will rely on manual time setting");
-  }
+  // No upstream network in AP mode: time arrives from the browser on the first page load
+  log("Clock drift correction: " + String(softClock.driftPpb / 1000.0, 3) + " ppm, UTC offset " + String(softClock.tzOffsetMinutes) + " min");
 
   log("Solenoid Controller initialized");
   log("Solenoid 1 (D2), Solenoid 2 (D3), Solenoid 3 (D4)");
   log("Button 1 (D7): Long press (>5s) for WiFi AP (if not auto-started), short press for Solenoids 1 & 2");
   log("Button 2 (D6): Short press for Solenoid 3");
+  log("Both buttons together: Stop all solenoids");
   
   log("Automatically starting WiFi Access Point...");
   setupAccessPoint();
 }
 
+void consoleBenchAdd(uint32_t elapsedUs);
+
 void loop() {
-  handleButtons();
-  unsigned long currentTime = millis();
-  
-  if (solenoid1Active && (currentTime - solenoid1StartTime >= solenoid1Settings.onTime * 60000UL)) {
-    deactivateSolenoid(1);
-    solenoid1Active = false;
+  if (consoleBenchRun.remaining == 0) {
+    schedulerTick();
+    return;
   }
-  if (solenoid2Active && (currentTime - solenoid2StartTime >= solenoid2Settings.onTime * 60000UL)) {
-    deactivateSolenoid(2);
-    solenoid2Active = false;
+  // bench tick: timed here so the pass is not nested inside the console task
+  uint64_t idleBefore = governorIdleUs;
+  uint32_t startUs = micros();
+  schedulerTick();
+  uint32_t elapsedUs = micros() - startUs;
+  uint32_t idleUs = governorIdleUs - idleBefore;
+  consoleBenchAdd(elapsedUs > idleUs ? elapsedUs - idleUs : 0); // The governor's idle delay is not work
+}
+
+// Run one task if it has been released, with CPU and deadline accounting
+void schedulerRun(uint8_t index) {
+  const Task& task = TASKS[index];
+  TaskStats& stats = taskStats[index];
+  uint32_t startUs = micros();
+  if (task.periodMs && (int32_t)(startUs - stats.releaseUs) < 0) {
+    return; // Not released yet
   }
-  if (solenoid3Active && (currentTime - solenoid3StartTime >= solenoid3Settings.onTime * 60000UL)) {
-    deactivateSolenoid(3);
-    solenoid3Active = false;
+
+  uint64_t idleBefore = governorIdleUs;
+  uint64_t sleptBefore = governorSleptUs;
+  task.run();
+  uint32_t endUs = micros();
+  uint32_t idleUs = governorIdleUs - idleBefore;
+  uint32_t runUs = endUs - startUs;
+  runUs = runUs > idleUs ? runUs - idleUs : 0;
+
+  stats.runs++;
+  stats.totalUs += runUs;
+  if (runUs > stats.maxUs) {
+    stats.maxUs = runUs;
   }
-  
-  if (apActive) {
-    server.handleClient();
-    if (MDNS.isRunning()) {
-        MDNS.update();
-    }
-    if (currentTime - wifiStartTime >= WIFI_AUTO_OFF_TIME) {
-      if (WiFi.softAPgetStationNum() == 0) {
-        log("No active WiFi connections for 20 minutes. Shutting down WiFi completely...");
-        shutdownWiFiCompletely();
-      } else {
-        wifiStartTime = currentTime;
-        log("Active WiFi connections detected. Keeping WiFi on.");
+  uint32_t latencyUs = endUs - stats.releaseUs;
+  if (latencyUs > stats.maxLatencyUs) {
+    stats.maxLatencyUs = latencyUs;
+  }
+  if (task.deadlineUs && latencyUs > task.deadlineUs) {
+    stats.misses++;
+    traceRecord(TRACE_INSTANT, TRACE_DEADLINE_MISS, index);
+  }
+
+  if (governorSleptUs != sleptBefore) {
+    // Nothing was pending across a light sleep: restart every task's timeline from now
+    for (uint8_t i = 0; i < TASK_COUNT; ++i) {
+      taskStats[i].releaseUs = endUs;
+    }
+    return;
+  }
+  if (task.periodMs == 0) {
+    stats.releaseUs = endUs;
+  } else {
+    stats.releaseUs += task.periodMs * 1000UL;
+    if ((int32_t)(endUs - stats.releaseUs) >= 0) {
+      stats.releaseUs = endUs + task.periodMs * 1000UL; // Overran a whole period: skip, don't burst
+    }
+  }
+}
+
+// One pass over the task table
+void schedulerTick() {
+  for (uint8_t i = 0; i < TASK_COUNT; ++i) {
+    if (!TASKS[i].critical) {
+      for (uint8_t c = 0; c < TASK_COUNT && TASKS[c].critical; ++c) {
+        schedulerRun(c);
       }
     }
+    schedulerRun(i);
+  }
+}
+
+// Switch off valves whose run time has elapsed
+void taskValves() {
+  unsigned long currentTime = millis();
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    if (solenoidActive[i] && (currentTime - solenoidStartTime[i] >= solenoidDurationMs[i])) {
+      deactivateSolenoid(i + 1);
+    }
+  }
+  pulseUpdate();
+}
+
+// Web server, mDNS and the access point auto-off
+void taskNetwork() {
+  if (!apActive) {
+    return;
+  }
+  server.handleClient();
+  if (MDNS.isRunning()) {
+      MDNS.update();
+  }
+  unsigned long currentTime = millis();
+  if (currentTime - wifiStartTime >= WIFI_AUTO_OFF_TIME) {
+    if (WiFi.softAPgetStationNum() == 0) {
+      log("No active WiFi connections for 20 minutes. Shutting down WiFi completely...");
+      shutdownWiFiCompletely();
+    } else {
+      wifiStartTime = currentTime;
+      log("Active WiFi connections detected. Keeping WiFi on.");
+    }
+  }
+}
+
+// GET /tasks: per-task CPU time, worst run time, worst latency and deadline misses.
+// /tasks?reset=1 clears the counters.
+void handleTasks() {
+  TraceScope trace(TRACE_HTTP_TASKS);
+  uint64_t nowUs = clockRawUs();
+  if (server.hasArg("reset")) {
+    for (uint8_t i = 0; i < TASK_COUNT; ++i) {
+      taskStats[i].runs = 0;
+      taskStats[i].misses = 0;
+      taskStats[i].maxUs = 0;
+      taskStats[i].maxLatencyUs = 0;
+      taskStats[i].totalUs = 0;
+    }
+    governorIdleUs = 0;
+    schedulerStartUs = nowUs;
   }
 
-  checkScheduledEvents();
+  DynamicJsonDocument doc(1536);
+  uint64_t elapsedUs = nowUs - schedulerStartUs;
+  doc["elapsedMs"] = (uint32_t)(elapsedUs / 1000);
+  doc["idlePercent"] = elapsedUs ? 100.0 * governorIdleUs / elapsedUs : 0.0;
+  JsonArray tasks = doc.createNestedArray("tasks");
+  for (uint8_t i = 0; i < TASK_COUNT; ++i) {
+    const TaskStats& stats = taskStats[i];
+    JsonObject task = tasks.createNestedObject();
+    task["name"] = TASKS[i].name;
+    task["priority"] = i;
+    task["critical"] = TASKS[i].critical;
+    task["periodMs"] = TASKS[i].periodMs;
+    task["deadlineUs"] = TASKS[i].deadlineUs;
+    task["runs"] = stats.runs;
+    task["cpuPercent"] = elapsedUs ? 100.0 * stats.totalUs / elapsedUs : 0.0;
+    task["avgUs"] = stats.runs ? (uint32_t)(stats.totalUs / stats.runs) : 0;
+    task["maxUs"] = stats.maxUs;
+    task["maxLatencyUs"] = stats.maxLatencyUs;
+    task["deadlineMisses"] = stats.misses;
+  }
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
 }
 
 void checkScheduledEvents() {
@@ -196,8 +933,14 @@ void checkScheduledEvents() {
     return; // Don't run schedules if time is not known
   }
 
-  time(&now); // Get current time_t
-  localtime_r(&now, &timeinfo); // Convert to struct tm
+  // Schedules have one-second resolution, so only evaluate them when the second changes
+  static time_t lastCheckedTime = 0;
+  clockUpdateLocalTime();
+  if (now == lastCheckedTime) {
+    return;
+  }
+  lastCheckedTime = now;
+  TraceScope trace(TRACE_CHECK_SCHEDULES);
 
   // Create a unique day identifier that works across year boundaries
   int currentDay = timeinfo.tm_year * 1000 + timeinfo.tm_yday;
@@ -205,267 +948,1287 @@ void checkScheduledEvents() {
   // Check schedules with improved timing logic
   // Allow trigger within a 2-minute window to avoid missing exact minute
   
-  // Solenoid 1 Schedule
-  if (solenoid1Settings.scheduleEnabled && currentDay != last_run_day[0]) {
-    int scheduleMinutes = solenoid1Settings.scheduleHour * 60 + solenoid1Settings.scheduleMinute;
-    int currentMinutes = timeinfo.tm_hour * 60 + timeinfo.tm_min;
-    
+  int currentMinutes = timeinfo.tm_hour * 60 + timeinfo.tm_min;
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    const SolenoidSettings& settings = *solenoidSettings[i];
+    if (!settings.scheduleEnabled || currentDay == last_run_day[i]) {
+      continue;
+    }
+    int scheduleMinutes = settings.scheduleHour * 60 + settings.scheduleMinute;
+
     // Trigger if we're within 2 minutes of scheduled time or past it (but haven't run today)
     if (currentMinutes >= scheduleMinutes && currentMinutes <= scheduleMinutes + 2) {
-      log("Solenoid 1 scheduled activation (" + String(solenoid1Settings.scheduleHour) + ":" + padZero(solenoid1Settings.scheduleMinute) + ")");
-      if (!solenoid1Active) {
-        activateSolenoid(1, solenoid1Settings.onTime * 60000UL);
-        solenoid1Active = true;
-        solenoid1StartTime = millis();
+      log("Solenoid " + String(i + 1) + " scheduled activation (" + String(settings.scheduleHour) + ":" + padZero(settings.scheduleMinute) + ")");
+      if (!solenoidActive[i]) {
+        activateScheduledSolenoid(i, settings.onTime * 60000UL);
       } else {
-        log("Solenoid 1 was already active, schedule trigger ignored for now.");
+        log("Solenoid " + String(i + 1) + " was already active, schedule trigger ignored for now.");
       }
-      last_run_day[0] = currentDay;
+      last_run_day[i] = currentDay;
     }
   }
 
-  // Solenoid 2 Schedule
-  if (solenoid2Settings.scheduleEnabled && currentDay != last_run_day[1]) {
-    int scheduleMinutes = solenoid2Settings.scheduleHour * 60 + solenoid2Settings.scheduleMinute;
-    int currentMinutes = timeinfo.tm_hour * 60 + timeinfo.tm_min;
-    
-    if (currentMinutes >= scheduleMinutes && currentMinutes <= scheduleMinutes + 2) {
-      log("Solenoid 2 scheduled activation (" + String(solenoid2Settings.scheduleHour) + ":" + padZero(solenoid2Settings.scheduleMinute) + ")");
-      if (!solenoid2Active) {
-        activateSolenoid(2, solenoid2Settings.onTime * 60000UL);
-        solenoid2Active = true;
-        solenoid2StartTime = millis();
-      } else {
-        log("Solenoid 2 was already active, schedule trigger ignored for now.");
-      }
-      last_run_day[1] = currentDay;
-    }
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    calendarCheck(i);
   }
+}
 
-  // Solenoid 3 Schedule
-  if (solenoid3Settings.scheduleEnabled && currentDay != last_run_day[2]) {
-    int scheduleMinutes = solenoid3Settings.scheduleHour * 60 + solenoid3Settings.scheduleMinute;
-    int currentMinutes = timeinfo.tm_hour * 60 + timeinfo.tm_min;
-    
-    if (currentMinutes >= scheduleMinutes && currentMinutes <= scheduleMinutes + 2) {
-      log("Solenoid 3 scheduled activation (" + String(solenoid3Settings.scheduleHour) + ":" + padZero(solenoid3Settings.scheduleMinute) + ")");
-      if (!solenoid3Active) {
-        activateSolenoid(3, solenoid3Settings.onTime * 60000UL);
-        solenoid3Active = true;
-        solenoid3StartTime = millis();
-      } else {
-        log("Solenoid 3 was already active, schedule trigger ignored for now.");
-      }
-      last_run_day[2] = currentDay;
+String calendarPath(uint8_t channel, bool temporary) {
+  return "/cal/ch" + String(channel + 1) + (temporary ? ".tmp" : ".bin");
+}
+
+void calendarBegin() {
+  if (!LittleFS.begin()) {
+    log("LittleFS mount failed, calendar disabled.");
+    return;
+  }
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    CalendarChannel& cal = calendars[i];
+    cal.count = 0;
+    cal.blockCount = 0;
+    cal.nextValid = false;
+    cal.exhausted = false;
+
+    File f = LittleFS.open(calendarPath(i, false), "r");
+    if (!f) {
+      continue;
+    }
+    CalendarFileHeader header;
+    bool ok = f.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              header.magic == CALENDAR_MAGIC_NUMBER && header.blockCount <= CALENDAR_MAX_BLOCKS &&
+              header.blockCount == (header.count + CALENDAR_BLOCK_EVENTS - 1) / CALENDAR_BLOCK_EVENTS &&
+              f.seek(sizeof(header) + header.count * sizeof(CalendarEvent), SeekSet) &&
+              f.read((uint8_t*)cal.blockStart, header.blockCount * sizeof(uint32_t)) == header.blockCount * sizeof(uint32_t);
+    f.close();
+    if (ok) {
+      cal.count = header.count;
+      cal.blockCount = header.blockCount;
+      log("Calendar for Solenoid " + String(i + 1) + ": " + String(cal.count) + " events");
+    } else {
+      log("Calendar file for Solenoid " + String(i + 1) + " is corrupt, ignoring it.");
     }
   }
 }
 
+void calendarInvalidateCursors() {
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    calendars[i].nextValid = false;
+    calendars[i].exhausted = false;
+  }
+}
 
-void handleButtons() {
-  bool button1Reading = digitalRead(BUTTON_1_PIN);
-  bool button2Reading = digitalRead(BUTTON_2_PIN);
-  unsigned long currentTime = millis();
-  
-  if (button1Reading != button1PrevReading) {
-    lastDebounceTime1 = currentTime;
-    button1PrevReading = button1Reading;
+// Find the first event of a channel starting at or after fromLocal
+bool calendarFindNext(uint8_t channel, uint32_t fromLocal, CalendarEvent& out) {
+  const CalendarChannel& cal = calendars[channel];
+  if (cal.count == 0) {
+    return false;
   }
-  
-  if ((currentTime - lastDebounceTime1) > debounceDelay) {
-    if (button1Reading != button1LastState) {
-        button1LastState = button1Reading;
-        if (button1Reading == LOW) {
-            button1PressTime = currentTime;
-            button1LongPressDetected = false;
-            log("Button 1 (D7) pressed.");
-        } else {
-            if (!button1LongPressDetected && (currentTime - button1PressTime < 5000)) {
-                log("Short press on Button 1 (D7). Activating Solenoids 1 & 2.");
-                if (!solenoid1Active) {
-                    activateSolenoid(1, solenoid1Settings.onTime * 60000UL);
-                    solenoid1Active = true;
-                    solenoid1StartTime = currentTime;
-                }
-                if (!solenoid2Active) {
-                    activateSolenoid(2, solenoid2Settings.onTime * 60000UL);
-                    solenoid2Active = true;
-                    solenoid2StartTime = currentTime;
-                }
-            }
-            button1LongPressDetected = false; 
-        }
-    } else if (button1Reading == LOW && !button1LongPressDetected) {
-        if ((currentTime - button1PressTime) > 5000) {
-            button1LongPressDetected = true;
-            log("Long press on Button 1 (D7). Ensuring Access Point is active.");
-            if (!apActive) {
-                setupAccessPoint(); // Try to start AP if not active
-            } else {
-                wifiStartTime = currentTime; // Reset AP timeout if button held
-                log("AP already active. Activity timer reset.");
-            }
-        }
-    }
+
+  // Blocks before the last one starting earlier than fromLocal hold only earlier events
+  uint16_t lo = 0, hi = cal.blockCount;
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    if (cal.blockStart[mid] < fromLocal) lo = mid + 1; else hi = mid;
   }
-  
-  if (button2Reading != button2PrevReading) {
-    lastDebounceTime2 = currentTime;
-    button2PrevReading = button2Reading;
+  uint32_t first = lo == 0 ? 0 : (uint32_t)(lo - 1) * CALENDAR_BLOCK_EVENTS;
+  uint32_t last = min(first + CALENDAR_BLOCK_EVENTS, cal.count);
+
+  File f = LittleFS.open(calendarPath(channel, false), "r");
+  if (!f) {
+    return false;
   }
-  
-  if ((currentTime - lastDebounceTime2) > debounceDelay) {
-    if (button2Reading != button2LastState) {
-        button2LastState = button2Reading;
-        if (button2Reading == LOW) {
-            log("Button 2 (D6) pressed. Activating Solenoid 3.");
-            if (!solenoid3Active) {
-                activateSolenoid(3, solenoid3Settings.onTime * 60000UL);
-                solenoid3Active = true;
-                solenoid3StartTime = currentTime;
-            }
-        }
-    }
+  CalendarEvent event;
+  while (first < last) {
+    uint32_t mid = (first + last) / 2;
+    f.seek(sizeof(CalendarFileHeader) + mid * sizeof(CalendarEvent), SeekSet);
+    f.read((uint8_t*)&event, sizeof(event));
+    if (event.startLocal < fromLocal) first = mid + 1; else last = mid;
   }
+  bool found = first < cal.count;
+  if (found) {
+    f.seek(sizeof(CalendarFileHeader) + first * sizeof(CalendarEvent), SeekSet);
+    found = f.read((uint8_t*)&out, sizeof(out)) == sizeof(out);
+  }
+  f.close();
+  return found;
 }
 
-void setupAccessPoint() {
-  if (apActive) {
-    log("WiFi Access Point is already active.");
-    wifiStartTime = millis(); // Reset AP timer on explicit call
+void calendarCheck(uint8_t channel) {
+  CalendarChannel& cal = calendars[channel];
+  if (cal.count == 0 || cal.exhausted) {
     return;
   }
-  
-  log("Setting up WiFi Access Point...");
-  
-  // Wake up WiFi if it was in forced sleep mode
-  WiFi.forceSleepWake();
-  delay(100); // Give time for WiFi to wake up
-  
-  // Ensure WiFi is in the correct mode
-  WiFi.mode(WIFI_AP);
-  
-  // Start the Access Point
-  if (!WiFi.softAP(ssid, password)) {
-    log("Failed to start Access Point! Retrying...");
-    delay(500);
-    WiFi.softAP(ssid, password);
+  uint32_t nowLocal = (uint32_t)now;
+  if (!cal.nextValid) {
+    cal.nextValid = calendarFindNext(channel, nowLocal - CALENDAR_TRIGGER_WINDOW, cal.next);
+    if (!cal.nextValid) {
+      cal.exhausted = true;
+      return;
+    }
   }
-  
-  IPAddress myIP = WiFi.softAPIP();
-  log("AP IP address: " + myIP.toString());
-  
-  if (MDNS.begin("solenoid")) {
-    MDNS.addService("http", "tcp", 80);
-    log("MDNS responder started. Access at http://solenoid.local");
+  if (nowLocal < cal.next.startLocal) {
+    return;
+  }
+
+  if (nowLocal <= cal.next.startLocal + CALENDAR_TRIGGER_WINDOW) {
+    log("Solenoid " + String(channel + 1) + " calendar activation (" + String(cal.next.durationMin) + " min)");
+    if (!solenoidActive[channel]) {
+      activateScheduledSolenoid(channel, cal.next.durationMin * 60000UL);
+    } else {
+      log("Solenoid " + String(channel + 1) + " was already active, calendar event ignored.");
+    }
   } else {
-    log("Error setting up MDNS responder!");
+    log("Solenoid " + String(channel + 1) + " missed a calendar event, skipping it.");
   }
-  
-  server.on("/", HTTP_GET, handleRoot);
-  server.on("/settings", HTTP_GET, handleGetSettings);
-  server.on("/settings", HTTP_POST, handleUpdateSettings);
-  server.on("/settime", HTTP_POST, handleSetTime); // New endpoint for time sync
-  server.on("/activateSolenoid1", HTTP_POST, handleActivateSolenoid1);
-  server.on("/activateSolenoid2", HTTP_POST, handleActivateSolenoid2);
-  server.on("/activateSolenoid3", HTTP_POST, handleActivateSolenoid3);
-  
-  server.begin();
-  apActive = true;
-  wifiStartTime = millis();
-  log("HTTP server started");
+  cal.nextValid = calendarFindNext(channel, cal.next.startLocal + 1, cal.next);
+  cal.exhausted = !cal.nextValid;
 }
 
-void shutdownWiFiCompletely() {
-  log("Initiating complete WiFi shutdown for power saving...");
-  
-  // Stop all active web server operations
-  server.stop();
-  log("Web server stopped");
-  
-  // Stop mDNS responder
-  if (MDNS.isRunning()) {
-    MDNS.end();
-    log("MDNS responder stopped");
+// Days since 1970-01-01 for a proleptic Gregorian date
+int32_t daysFromCivil(int32_t y, uint32_t m, uint32_t d) {
+  y -= m <= 2;
+  const int32_t era = (y >= 0 ? y : y - 399) / 400;
+  const uint32_t yoe = (uint32_t)(y - era * 400);
+  const uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+void calendarUploadFail(const String& message) {
+  if (calendarUpload->error.length() == 0) {
+    calendarUpload->error = message;
   }
-  
-  // Disconnect all connected stations and stop AP
-  WiFi.softAPdisconnect(true);
-  log("Access Point disconnected");
-  
-  // Wait a moment for clean disconnection
-  delay(100);
-  
-  // Ensure WiFi is completely off
-  WiFi.mode(WIFI_OFF);
-  WiFi.forceSleepBegin();
-  log("WiFi radio disabled and forced into sleep mode");
-  
-  // Additional power saving - turn off WiFi modem completely
-  delay(100);
-  
-  // Set flag to indicate WiFi is off
-  apActive = false;
-  
-  // Enable modem sleep mode for maximum power savings when WiFi is off
-  // This will significantly reduce power consumption
-  wifi_set_sleep_type(MODEM_SLEEP_T);
-  
-  log("Complete WiFi shutdown successful - significant power reduction achieved");
-  log("Use long press on Button 1 (D7) to reactivate WiFi when needed");
 }
 
-void handleSetTime() {
-  if (server.hasArg("plain")) {
-    String body = server.arg("plain");
-    DynamicJsonDocument doc(256); // Sufficient for time data
-    DeserializationError error = deserializeJson(doc, body);
-    
+void calendarAddEvent(uint8_t channelNum, uint32_t startLocal, uint16_t durationMin) {
+  if (channelNum < 1 || channelNum > SOLENOID_COUNT) {
+    calendarUploadFail("Invalid channel " + String(channelNum));
+    return;
+  }
+  if (durationMin == 0) {
+    calendarUploadFail("Zero duration");
+    return;
+  }
+  uint8_t i = channelNum - 1;
+  CalendarChannel& built = calendarUpload->built[i];
+  if (built.count > 0 && startLocal < built.next.startLocal) {
+    calendarUploadFail("Events for Solenoid " + String(channelNum) + " are not sorted by time");
+    return;
+  }
+  if (built.count >= (uint32_t)CALENDAR_MAX_BLOCKS * CALENDAR_BLOCK_EVENTS) {
+    calendarUploadFail("Too many events for Solenoid " + String(channelNum));
+    return;
+  }
+
+  File& f = calendarUpload->files[i];
+  if (!f) {
+    CalendarFileHeader placeholder = {0, 0, 0};
+    f = LittleFS.open(calendarPath(i, true), "w+");
+    if (!f || f.write((const uint8_t*)&placeholder, sizeof(placeholder)) != sizeof(placeholder)) {
+      calendarUploadFail("Cannot create calendar file");
+      return;
+    }
+  }
+  if (built.count % CALENDAR_BLOCK_EVENTS == 0) {
+    built.blockStart[built.blockCount++] = startLocal;
+  }
+  CalendarEvent event = {startLocal, durationMin, 0};
+  if (f.write((const uint8_t*)&event, sizeof(event)) != sizeof(event)) {
+    calendarUploadFail("Flash full");
+    return;
+  }
+  built.next = event; // Last written event, for the ordering check
+  built.count++;
+}
+
+// CSV line: YYYY-MM-DD HH:MM,channel,minutes (local time). Blank, '#' and header lines are skipped.
+void calendarParseLine(char* line) {
+  calendarUpload->lineNumber++;
+  if (line[0] < '0' || line[0] > '9') {
+    return;
+  }
+  int year, month, day, hour, minute, channel, duration;
+  if (sscanf(line, "%4d-%2d-%2d%*c%2d:%2d,%d,%d", &year, &month, &day, &hour, &minute, &channel, &duration) != 7 ||
+      month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || duration < 0 || duration > 65535) {
+    calendarUploadFail("Bad CSV line " + String(calendarUpload->lineNumber));
+    return;
+  }
+  uint32_t startLocal = (uint32_t)daysFromCivil(year, month, day) * 86400UL + hour * 3600UL + minute * 60UL;
+  calendarAddEvent(channel, startLocal, duration);
+}
+
+void calendarUploadFeed(const uint8_t* data, size_t len) {
+  CalendarUpload& up = *calendarUpload;
+  up.bytes += len;
+  for (size_t i = 0; i < len && up.error.length() == 0; ++i) {
+    if (up.binary) {
+      // Packed little-endian records: uint32 startLocal, uint8 channel, uint8 reserved, uint16 minutes
+      up.record[up.recordLen++] = data[i];
+      if (up.recordLen == sizeof(up.record)) {
+        up.recordLen = 0;
+        uint32_t startLocal = up.record[0] | (up.record[1] << 8) | (up.record[2] << 16) | ((uint32_t)up.record[3] << 24);
+        calendarAddEvent(up.record[4], startLocal, up.record[6] | (up.record[7] << 8));
+      }
+    } else if (data[i] == '\r') {
+      continue; // CRLF line endings
+    } else if (data[i] == '\n') {
+      up.line[up.lineLen] = '\0';
+      calendarParseLine(up.line);
+      up.lineLen = 0;
+    } else if (up.lineLen < sizeof(up.line) - 1) {
+      up.line[up.lineLen++] = (char)data[i];
+    } else {
+      calendarUploadFail("Line " + String(up.lineNumber + 1) + " too long");
+    }
+  }
+}
+
+void calendarUploadEnd() {
+  CalendarUpload& up = *calendarUpload;
+  if (!up.binary && up.lineLen > 0 && up.error.length() == 0) {
+    up.line[up.lineLen] = '\0';
+    calendarParseLine(up.line);
+  }
+  if (up.binary && up.recordLen != 0) {
+    calendarUploadFail("Truncated binary record");
+  }
+
+  for (uint8_t i = 0; i < SOLENOID_COUNT && up.error.length() == 0; ++i) {
+    File& f = up.files[i];
+    if (!f) {
+      continue;
+    }
+    CalendarChannel& built = up.built[i];
+    CalendarFileHeader header = {CALENDAR_MAGIC_NUMBER, built.count, built.blockCount};
+    size_t indexBytes = built.blockCount * sizeof(uint32_t);
+    if (f.write((const uint8_t*)built.blockStart, indexBytes) != indexBytes || !f.seek(0, SeekSet) ||
+        f.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) {
+      calendarUploadFail("Flash full");
+    }
+  }
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    if (up.files[i]) {
+      up.files[i].close();
+    }
+  }
+  if (up.error.length() > 0) {
+    for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+      LittleFS.remove(calendarPath(i, true));
+    }
+    return;
+  }
+
+  // An upload replaces the whole calendar; channels without events are cleared
+  uint32_t events = 0;
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    LittleFS.remove(calendarPath(i, false));
+    if (up.built[i].count > 0) {
+      LittleFS.rename(calendarPath(i, true), calendarPath(i, false));
+    }
+    calendars[i] = up.built[i];
+    calendars[i].nextValid = false;
+    calendars[i].exhausted = false;
+    events += up.built[i].count;
+  }
+  calendarLastUpload = {events, up.bytes, millis() - up.startMs};
+  log("Calendar uploaded: " + String(events) + " events, " + String(up.bytes) + " bytes in " + String(calendarLastUpload.durationMs) + " ms");
+}
+
+void handleCalendarUpload() {
+  TraceScope trace(TRACE_HTTP_CALENDAR_CHUNK);
+  HTTPUpload& upload = server.upload();
+  switch (upload.status) {
+    case UPLOAD_FILE_START:
+      delete calendarUpload;
+      calendarUpload = new CalendarUpload();
+      calendarUpload->binary = upload.filename.endsWith(".bin");
+      calendarUpload->startMs = millis();
+      calendarUploadActive = true;
+      LittleFS.mkdir("/cal");
+      log("Calendar upload started: " + upload.filename);
+      break;
+    case UPLOAD_FILE_WRITE:
+      if (calendarUpload) {
+        calendarUploadFeed(upload.buf, upload.currentSize);
+      }
+      break;
+    case UPLOAD_FILE_END:
+      calendarUploadActive = false;
+      if (calendarUpload) {
+        calendarUploadEnd();
+      }
+      break;
+    case UPLOAD_FILE_ABORTED:
+      // The server does not call handleCalendarUploadDone() after an abort, so free the state here
+      calendarUploadActive = false;
+      if (calendarUpload) {
+        calendarUploadFail("Upload aborted");
+        calendarUploadEnd();
+        log("Calendar upload rejected: " + calendarUpload->error);
+        delete calendarUpload;
+        calendarUpload = nullptr;
+      }
+      break;
+  }
+}
+
+void handleCalendarUploadDone() {
+  TraceScope trace(TRACE_HTTP_CALENDAR_DONE);
+  if (!calendarUpload) {
+    server.send(400, "application/json", "{\"status\":\"error\",\"message\":\"No calendar file received\"}");
+    return;
+  }
+  String error = calendarUpload->error;
+  delete calendarUpload;
+  calendarUpload = nullptr;
+
+  if (error.length() > 0) {
+    log("Calendar upload rejected: " + error);
+    server.send(400, "application/json", "{\"status\":\"error\",\"message\":\"" + error + "\"}");
+    return;
+  }
+  uint32_t kbPerSec = calendarLastUpload.durationMs ? calendarLastUpload.bytes / calendarLastUpload.durationMs : 0;
+  server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"Calendar stored\",\"events\":" +
+              String(calendarLastUpload.events) + ",\"ms\":" + String(calendarLastUpload.durationMs) + ",\"kBps\":" + String(kbPerSec) + "}");
+}
+
+// GET /calendar[?bench=N]: event counts, the next event per channel and, optionally,
+// the cost of N random next-event lookups
+void handleGetCalendar() {
+  TraceScope trace(TRACE_HTTP_GET_CALENDAR);
+  DynamicJsonDocument doc(768);
+  JsonArray channels = doc.createNestedArray("channels");
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    JsonObject ch = channels.createNestedObject();
+    ch["events"] = calendars[i].count;
+    ch["next"] = calendars[i].nextValid ? calendars[i].next.startLocal : 0;
+  }
+  doc["lastUploadEvents"] = calendarLastUpload.events;
+  doc["lastUploadBytes"] = calendarLastUpload.bytes;
+  doc["lastUploadMs"] = calendarLastUpload.durationMs;
+
+  int lookups = server.hasArg("bench") ? constrain(server.arg("bench").toInt(), 1, 10000) : 0;
+  if (lookups > 0) {
+    uint32_t totalUs = 0, maxUs = 0;
+    int done = 0;
+    for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+      const CalendarChannel& cal = calendars[i];
+      if (cal.count == 0) {
+        continue;
+      }
+      uint32_t span = cal.blockStart[cal.blockCount - 1] - cal.blockStart[0] + 1;
+      for (int n = 0; n < lookups; ++n) {
+        CalendarEvent event;
+        uint32_t t0 = micros();
+        calendarFindNext(i, cal.blockStart[0] + random(span), event);
+        uint32_t elapsed = micros() - t0;
+        totalUs += elapsed;
+        maxUs = max(maxUs, elapsed);
+        done++;
+        yield();
+      }
+    }
+    doc["benchLookups"] = done;
+    doc["benchAvgUs"] = done ? totalUs / done : 0;
+    doc["benchMaxUs"] = maxUs;
+  }
+
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+
+IRAM_ATTR void profilerSample() {
+  uint32_t pc;
+  __asm__ __volatile__("rsr %0, epc1" : "=a"(pc)); // PC of the code this interrupt preempted
+  uint32_t slot = ((pc >> 1) * 2654435761UL) >> (32 - PROFILER_BUCKET_BITS);
+  for (uint8_t probe = 0; probe < PROFILER_MAX_PROBES; ++probe) {
+    ProfilerBucket& bucket = profilerHistogram[(slot + probe) & (PROFILER_BUCKETS - 1)];
+    if (bucket.pc == pc || bucket.pc == 0) {
+      bucket.pc = pc;
+      bucket.count++;
+      profilerSamples++;
+      return;
+    }
+  }
+  profilerDropped++;
+}
+
+void profilerStart(uint32_t hz) {
+  profilerStop();
+  memset(profilerHistogram, 0, sizeof(profilerHistogram));
+  profilerSamples = 0;
+  profilerDropped = 0;
+  profilerHz = hz;
+  timer1_isr_init();
+  timer1_attachInterrupt(profilerSample);
+  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_LOOP); // 5 MHz ticks
+  timer1_write(5000000UL / hz);
+  profilerRunning = true;
+  log("Profiler started at " + String(hz) + " Hz");
+}
+
+void profilerStop() {
+  if (!profilerRunning) {
+    return;
+  }
+  timer1_disable();
+  timer1_detachInterrupt();
+  profilerRunning = false;
+  log("Profiler stopped after " + String(profilerSamples) + " samples");
+}
+
+// /profile?start=HZ starts sampling (clearing the histogram), /profile?stop=1 stops it and
+// /profile dumps "pc count" lines with the raw ELF addresses for tools/profile_symbolize.py
+void handleProfile() {
+  TraceScope trace(TRACE_HTTP_PROFILE);
+  if (server.hasArg("start")) {
+    profilerStart(constrain(server.arg("start").toInt(), 10, 10000));
+    server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"Profiler started\",\"hz\":" + String(profilerHz) + "}");
+    return;
+  }
+  if (server.hasArg("stop")) {
+    profilerStop();
+    server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"Profiler stopped\",\"samples\":" + String(profilerSamples) + "}");
+    return;
+  }
+
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "text/plain", "");
+  char buf[512];
+  size_t len = snprintf(buf, sizeof(buf), "# hz %u running %u samples %u dropped %u\n",
+                        profilerHz, profilerRunning, profilerSamples, profilerDropped);
+  for (uint16_t i = 0; i < PROFILER_BUCKETS; ++i) {
+    const ProfilerBucket& bucket = profilerHistogram[i];
+    if (bucket.count == 0) {
+      continue;
+    }
+    if (len > sizeof(buf) - 24) {
+      server.sendContent(buf, len);
+      len = 0;
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "0x%08x %u\n", bucket.pc, bucket.count);
+  }
+  server.sendContent(buf, len);
+  server.sendContent("");
+}
+
+void soilSelectSensor(uint8_t sensor) {
+  for (uint8_t bit = 0; bit < SOIL_MUX_PIN_COUNT; ++bit) {
+    digitalWrite(SOIL_MUX_PINS[bit], (sensor >> bit) & 1);
+  }
+  soilCurrentSensor = sensor;
+  soilSettling = SOIL_MUX_PIN_COUNT > 0;
+}
+
+void soilBegin() {
+  for (uint8_t bit = 0; bit < SOIL_MUX_PIN_COUNT; ++bit) {
+    pinMode(SOIL_MUX_PINS[bit], OUTPUT);
+  }
+  soilSelectSensor(0);
+}
+
+// One ADC read; the scheduler runs this every SOIL_ADC_INTERVAL
+void soilSample() {
+  if (!soilSettings.enabled) {
+    return;
+  }
+
+  uint16_t raw = analogRead(A0);
+  if (soilSettling) {
+    soilSettling = false;
+    return;
+  }
+  if (!soilFilterRead(soilFilters[soilCurrentSensor], soilSettings, raw)) {
+    return;
+  }
+  if (SOIL_SENSOR_COUNT > 1) {
+    soilSelectSensor((soilCurrentSensor + 1) % SOIL_SENSOR_COUNT);
+  }
+}
+
+// Start a schedule- or calendar-driven activation, skipped or shortened by soil moisture
+void activateScheduledSolenoid(uint8_t channel, unsigned long durationMs) {
+  int8_t sensor = SOIL_SENSOR_FOR_CHANNEL[channel];
+  if (!soilSettings.enabled || sensor < 0) {
+    pulseStart(channel, durationMs, SOURCE_SCHEDULE);
+    return;
+  }
+
+  const SoilFilter& f = soilFilters[sensor];
+  SoilDecision decision = SOIL_RUN;
+  if (!f.valid) {
+    decision = SOIL_NO_DATA;
+  } else if (f.wet || f.percent >= soilSettings.wetOnPercent) {
+    decision = SOIL_SKIPPED;
+    durationMs = 0;
+  } else if (f.percent > soilSettings.dryPercent) {
+    // Scale linearly from the full duration at dryPercent down to nothing at wetOnPercent
+    durationMs = durationMs * (soilSettings.wetOnPercent - f.percent) / (soilSettings.wetOnPercent - soilSettings.dryPercent);
+    decision = durationMs >= 60000UL ? SOIL_SHORTENED : SOIL_SKIPPED;
+    if (decision == SOIL_SKIPPED) {
+      durationMs = 0;
+    }
+  }
+
+  soilLastDecision[channel] = {now, f.percent, decision, (uint16_t)(durationMs / 60000UL)};
+  traceRecord(TRACE_INSTANT, TRACE_SOIL_DECISION, channel | (decision << 8));
+  log("Solenoid " + String(channel + 1) + " soil moisture " + String(f.percent) + "%: " + SOIL_DECISION_NAMES[decision]);
+  if (durationMs > 0) {
+    pulseStart(channel, durationMs, SOURCE_SCHEDULE);
+  }
+}
+
+// GET /soil: filtered reading per sensor and the last schedule decision per valve
+void handleSoil() {
+  TraceScope trace(TRACE_HTTP_SOIL);
+  DynamicJsonDocument doc(768);
+  doc["enabled"] = soilSettings.enabled;
+  JsonArray sensors = doc.createNestedArray("sensors");
+  for (uint8_t i = 0; i < SOIL_SENSOR_COUNT; ++i) {
+    JsonObject sensor = sensors.createNestedObject();
+    sensor["valid"] = soilFilters[i].valid;
+    sensor["filtered"] = soilFilters[i].filtered;
+    sensor["percent"] = soilFilters[i].percent;
+    sensor["wet"] = soilFilters[i].wet;
+  }
+  JsonArray decisions = doc.createNestedArray("decisions");
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    JsonObject d = decisions.createNestedObject();
+    d["time"] = (uint32_t)soilLastDecision[i].time;
+    d["percent"] = soilLastDecision[i].percent;
+    d["decision"] = soilLastDecision[i].time ? SOIL_DECISION_NAMES[soilLastDecision[i].decision] : "none";
+    d["minutes"] = soilLastDecision[i].minutes;
+  }
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// pulse_engine.h hooks
+uint64_t pulseNowMs() {
+  return clockRawUs() / 1000; // Keeps counting across light sleep, unlike millis()
+}
+
+bool pulseValveIsOpen(uint8_t channel) {
+  return solenoidActive[channel];
+}
+
+void pulseValveOpen(uint8_t channel, uint32_t durationMs) {
+  const PulseProgram& program = pulsePrograms[channel];
+  activateSolenoid(channel + 1, durationMs, (ActivationSource)program.source);
+  solenoidCountsActivation[channel] = program.cycle == 0; // A whole program is one activation
+}
+
+void pulseValveClose(uint8_t channel) {
+  deactivateSolenoid(channel + 1);
+}
+
+void pulsePhaseChanged(uint8_t channel) {
+  traceRecord(TRACE_INSTANT, TRACE_PULSE_PHASE, channel | (pulsePrograms[channel].phase << 8));
+}
+
+void pulseNotify(uint8_t channel, PulseNotice notice) {
+  const PulseProgram& program = pulsePrograms[channel];
+  switch (notice) {
+    case PULSE_NOTICE_BUSY:
+      log("Solenoid " + String(channel + 1) + " program already running.");
+      break;
+    case PULSE_NOTICE_STARTED:
+      if (program.cycles > 1) {
+        log("Solenoid " + String(channel + 1) + " program: " + String(program.cycles) + " pulses, " + String(program.soakMs / 60000) + " min soak");
+      }
+      break;
+    case PULSE_NOTICE_STOPPED:
+      log("Solenoid " + String(channel + 1) + " program stopped.");
+      break;
+    case PULSE_NOTICE_DONE:
+      if (program.cycles > 1) {
+        log("Solenoid " + String(channel + 1) + " program done in " + String((uint32_t)((pulseNowMs() - program.startedMs) / 60000)) +
+            " min, waited " + String(program.waitedMs / 1000) + " s for supply");
+      }
+      break;
+  }
+}
+
+void pulseToJson(uint8_t channel, JsonObject doc) {
+  const PulseProgram& program = pulsePrograms[channel];
+  uint64_t nowMs = pulseNowMs();
+  doc["phase"] = PULSE_PHASE_NAMES[program.phase];
+  if (program.phase == PULSE_IDLE) {
+    return;
+  }
+  doc["cycle"] = program.cycle + 1;
+  doc["cycles"] = program.cycles;
+  doc["phaseRemainingMs"] = program.phase != PULSE_WAITING && program.deadlineMs > nowMs ? (uint32_t)(program.deadlineMs - nowMs) : 0;
+  doc["elapsedMs"] = (uint32_t)(nowMs - program.startedMs);
+  doc["waitedMs"] = program.waitedMs;
+  doc["worstLatenessMs"] = program.worstLatenessMs;
+}
+
+// GET /pulse: program progress per channel
+void handleGetPulse() {
+  TraceScope trace(TRACE_HTTP_PULSE);
+  DynamicJsonDocument doc(1024);
+  doc["supplyValves"] = pulseSupplyValves;
+  JsonArray channels = doc.createNestedArray("channels");
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    JsonObject channel = channels.createNestedObject();
+    pulseToJson(i, channel);
+    if (pulsePrograms[i].phase != PULSE_IDLE) {
+      JsonArray pulses = channel.createNestedArray("pulseMs");
+      for (uint8_t k = 0; k < pulsePrograms[i].cycles; ++k) {
+        pulses.add(pulsePrograms[i].pulseMs[k]);
+      }
+      channel["soakMs"] = pulsePrograms[i].soakMs;
+    }
+  }
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// POST /pulse {"valve":n} runs the valve's program for its ON time; {"valve":n,"stop":true} stops it
+void handlePostPulse() {
+  TraceScope trace(TRACE_HTTP_PULSE);
+  DynamicJsonDocument doc(128);
+  if (!server.hasArg("plain") || deserializeJson(doc, server.arg("plain"))) {
+    server.send(400, "application/json", "{\"status\":\"error\",\"message\":\"Expected {valve, stop}\"}");
+    return;
+  }
+  int valve = doc["valve"] | 0;
+  if (valve < 1 || valve > SOLENOID_COUNT) {
+    server.send(400, "application/json", "{\"status\":\"error\",\"message\":\"Invalid valve\"}");
+    return;
+  }
+  if (doc["stop"] | false) {
+    pulseCancel(valve - 1);
+  } else {
+    pulseStart(valve - 1, solenoidSettings[valve - 1]->onTime * 60000UL, SOURCE_WEB);
+  }
+  server.send(200, "application/json", "{\"status\":\"success\",\"phase\":\"" + String(PULSE_PHASE_NAMES[pulsePrograms[valve - 1].phase]) + "\"}");
+}
+
+GovernorState governorSelectState() {
+  if (calendarUploadActive || (apActive && millis() - lastHttpActivity < GOV_ACTIVITY_HOLD_TIME) ||
+      millis() - lastConsoleActivity < GOV_ACTIVITY_HOLD_TIME) {
+    return GOV_PERFORMANCE;
+  }
+  if (apActive) {
+    return GOV_IDLE_AP;
+  }
+  bool anyValveActive = false;
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    anyValveActive |= solenoidActive[i];
+  }
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    anyValveActive |= pulsePrograms[i].phase == PULSE_WAITING;
+  }
+  if (anyValveActive || !buttonsIdle() || profilerRunning || consoleOut.count > 0) {
+    return GOV_MODEM_SLEEP;
+  }
+  return GOV_LIGHT_SLEEP;
+}
+
+IRAM_ATTR void governorWakeup() {
+  governorWoke = true;
+}
+
+// Forced light sleep with the radio already off. Returns the time actually slept.
+uint64_t governorLightSleep(uint32_t sleepMs) {
+  Serial.flush();
+  // shutdownWiFiCompletely() left FPM open in forced modem sleep, which would make the light
+  // sleep request below fail; end it here and put the radio back to sleep afterwards
+  wifi_fpm_do_wakeup();
+  wifi_fpm_close();
+  for (uint8_t i = 0; i < BUTTON_COUNT; ++i) {
+    gpio_pin_wakeup_enable(GPIO_ID_PIN(BUTTON_PINS[i]), GPIO_PIN_INTR_LOLEVEL);
+  }
+  gpio_pin_wakeup_enable(GPIO_ID_PIN(CONSOLE_RX_PIN), GPIO_PIN_INTR_LOLEVEL); // Start bit of a console byte
+  governorWoke = false;
+  wifi_fpm_set_sleep_type(LIGHT_SLEEP_T);
+  wifi_fpm_open();
+  wifi_fpm_set_wakeup_cb(governorWakeup);
+
+  traceRecord(TRACE_BEGIN, TRACE_LIGHT_SLEEP);
+  uint32_t rtcStart = system_get_rtc_time();
+  uint32_t rtcPeriod = system_rtc_clock_cali_proc(); // us per RTC tick, Q12 fixed point
+  bool sleeping = wifi_fpm_do_sleep(sleepMs * 1000) == 0;
+  // The chip sleeps inside the first delay(); millis() does not advance while asleep.
+  // If the request was refused nothing will set governorWoke, so do not wait for it.
+  for (uint32_t waited = 0; sleeping && waited <= sleepMs && !governorWoke; ++waited) {
+    delay(1);
+  }
+  uint64_t sleptUs = sleeping ? ((uint64_t)(system_get_rtc_time() - rtcStart) * rtcPeriod) >> 12 : 0;
+  traceRecord(TRACE_END, TRACE_LIGHT_SLEEP);
+
+  wifi_fpm_close();
+  gpio_pin_wakeup_disable();
+  setupButtons(); // Restore the edge interrupts the wakeup configuration replaced
+  WiFi.forceSleepBegin();
+
+  if (!sleeping) {
+    governorSleepFailures++;
+    delay(GOV_MODEM_SLEEP_DELAY);
+    return 0;
+  }
+
+  // The press that woke us happened while the edge interrupt was off: replay it
+  bool buttonWake = false;
+  for (uint8_t i = 0; i < BUTTON_COUNT; ++i) {
+    if (digitalRead(BUTTON_PINS[i]) == LOW) {
+      noInterrupts();
+      queueButtonEdge(i);
+      interrupts();
+      buttonWake = true;
+    }
+  }
+  governorLightSleeps++;
+  governorButtonWakeups += buttonWake;
+  return sleptUs;
+}
+
+// Account residency for the state that just ended, pick the next one and idle accordingly
+void governorUpdate() {
+  uint64_t nowUs = clockRawUs();
+  governorResidencyUs[governorState] += nowUs - governorLastUpdateUs;
+  governorLastUpdateUs = nowUs;
+
+  GovernorState next = governorSelectState();
+  if (next != governorState) {
+    uint8_t mhz = next == GOV_PERFORMANCE ? SYS_CPU_160MHZ : SYS_CPU_80MHZ;
+    if (system_get_cpu_freq() != mhz) {
+      system_update_cpu_freq(mhz);
+    }
+    governorState = next;
+    traceRecord(TRACE_INSTANT, TRACE_GOVERNOR_STATE, next);
+  }
+
+  uint64_t idleStartUs = clockRawUs();
+  switch (governorState) {
+    case GOV_PERFORMANCE:
+      break;
+    case GOV_IDLE_AP:
+      delay(GOV_IDLE_AP_DELAY);
+      break;
+    case GOV_MODEM_SLEEP:
+      delay(GOV_MODEM_SLEEP_DELAY);
+      break;
+    case GOV_LIGHT_SLEEP: {
+      uint32_t sleepMs = GOV_LIGHT_SLEEP_MAX;
+      if (time_synced) {
+        // Wake in time for the next calendar event
+        for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+          const CalendarChannel& cal = calendars[i];
+          if (cal.nextValid && cal.next.startLocal > (uint32_t)now) {
+            sleepMs = min(sleepMs, (uint32_t)((cal.next.startLocal - (uint32_t)now) * 1000UL));
+          }
+        }
+      }
+      // and for the end of a soak
+      uint64_t nowMs = clockRawUs() / 1000;
+      for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+        const PulseProgram& program = pulsePrograms[i];
+        if (program.phase == PULSE_SOAK) {
+          uint64_t dueMs = program.deadlineMs > nowMs ? program.deadlineMs - nowMs : 0;
+          sleepMs = dueMs < sleepMs ? (uint32_t)dueMs : sleepMs;
+        }
+      }
+      if (sleepMs == 0) {
+        break;
+      }
+      governorSleptUs += governorLightSleep(sleepMs);
+      break;
+    }
+    default:
+      break;
+  }
+  governorIdleUs += clockRawUs() - idleStartUs;
+}
+
+// GET /power: current state, CPU clock and per-state residency
+void handlePower() {
+  TraceScope trace(TRACE_HTTP_POWER);
+  governorUpdate(); // Bring residency up to date
+  DynamicJsonDocument doc(512);
+  doc["state"] = GOVERNOR_STATE_NAMES[governorState];
+  doc["cpuMHz"] = system_get_cpu_freq();
+  uint64_t totalUs = 0;
+  for (uint8_t i = 0; i < GOV_STATE_COUNT; ++i) {
+    totalUs += governorResidencyUs[i];
+  }
+  JsonObject residency = doc.createNestedObject("residencyMs");
+  JsonObject percent = doc.createNestedObject("residencyPercent");
+  for (uint8_t i = 0; i < GOV_STATE_COUNT; ++i) {
+    residency[GOVERNOR_STATE_NAMES[i]] = (uint32_t)(governorResidencyUs[i] / 1000);
+    percent[GOVERNOR_STATE_NAMES[i]] = totalUs ? 100.0 * governorResidencyUs[i] / totalUs : 0.0;
+  }
+  doc["lightSleeps"] = governorLightSleeps;
+  doc["buttonWakeups"] = governorButtonWakeups;
+  doc["lightSleepFailures"] = governorSleepFailures;
+
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// GET /trace dumps the ring buffer, oldest record first:
+//   "TRC1", uint16 version, uint16 name count, the names NUL-terminated,
+//   uint32 record count, then packed little-endian TraceRecords.
+// /trace?clear=1 empties the buffer; /trace?enable=0|1 pauses or resumes recording.
+void handleTrace() {
+  if (server.hasArg("clear") || server.hasArg("enable")) {
+    if (server.hasArg("clear")) {
+      uint32_t savedPs = xt_rsil(15);
+      traceHead = 0;
+      traceCount = 0;
+      xt_wsr_ps(savedPs);
+    }
+    if (server.hasArg("enable")) {
+      traceEnabled = server.arg("enable").toInt() != 0;
+    }
+    server.send(200, "application/json", "{\"status\":\"success\",\"enabled\":" + String(traceEnabled ? "true" : "false") + "}");
+    return;
+  }
+
+  bool wasEnabled = traceEnabled;
+  traceEnabled = false; // Freeze the buffer while it is streamed
+
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/octet-stream", "");
+  uint8_t header[8] = {'T', 'R', 'C', '1', 1, 0, TRACE_ID_COUNT, 0};
+  server.sendContent((const char*)header, sizeof(header));
+  for (uint8_t i = 0; i < TRACE_ID_COUNT; ++i) {
+    server.sendContent(TRACE_NAMES[i], strlen(TRACE_NAMES[i]) + 1);
+  }
+  uint32_t count = traceCount;
+  server.sendContent((const char*)&count, sizeof(count));
+
+  uint16_t index = (traceHead - traceCount) & (TRACE_BUFFER_SIZE - 1);
+  uint16_t remaining = traceCount;
+  while (remaining > 0) {
+    uint16_t contiguous = TRACE_BUFFER_SIZE - index;
+    uint16_t run = remaining < contiguous ? remaining : contiguous;
+    server.sendContent((const char*)&traceBuffer[index], run * sizeof(TraceRecord));
+    index = (index + run) & (TRACE_BUFFER_SIZE - 1);
+    remaining -= run;
+  }
+  server.sendContent("");
+  traceEnabled = wasEnabled;
+}
+
+IRAM_ATTR void queueButtonEdge(uint8_t button) {
+  uint8_t head = buttonEdgeHead.load(std::memory_order_relaxed);
+  uint8_t next = (head + 1) & (BUTTON_QUEUE_SIZE - 1);
+  if (next == buttonEdgeTail.load(std::memory_order_acquire)) {
+    buttonEdgeOverflow = true; // Contact bounce storm; handleButtons() resynchronises from the pin
+    return;
+  }
+  uint8_t level = (GPI >> BUTTON_PINS[button]) & 1;
+  buttonEdgeQueue[head] = {(uint32_t)micros(), button, level};
+  traceRecord(TRACE_INSTANT | TRACE_FROM_ISR, TRACE_BUTTON_EDGE, button | (level << 8));
+  buttonEdgeHead.store(next, std::memory_order_release);
+}
+
+IRAM_ATTR void onButton1Edge() { queueButtonEdge(0); }
+IRAM_ATTR void onButton2Edge() { queueButtonEdge(1); }
+
+void setupButtons() {
+  for (uint8_t i = 0; i < BUTTON_COUNT; ++i) {
+    pinMode(BUTTON_PINS[i], INPUT_PULLUP);
+    buttons[i].rawLevel = digitalRead(BUTTON_PINS[i]);
+  }
+  attachInterrupt(digitalPinToInterrupt(BUTTON_1_PIN), onButton1Edge, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(BUTTON_2_PIN), onButton2Edge, CHANGE);
+}
+
+// True when no edge is queued and no gesture is in progress, so the CPU may idle
+bool buttonsIdle() {
+  if (buttonEdgeHead.load(std::memory_order_acquire) != buttonEdgeTail.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  for (uint8_t i = 0; i < BUTTON_COUNT; ++i) {
+    const ButtonState& b = buttons[i];
+    if (b.pressed || b.clickPending || b.rawLevel == LOW) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void dispatchButtonGesture(uint8_t button, ButtonGesture gesture, uint32_t edgeUs) {
+  ButtonAction action = buttonActions[button][gesture];
+  if (!action) {
+    return;
+  }
+  log(String(GESTURE_NAMES[gesture]) + " on " + BUTTON_NAMES[button] + ".");
+  traceRecord(TRACE_INSTANT, TRACE_BUTTON_GESTURE, button | (gesture << 8));
+  action(button);
+
+  uint32_t latencyUs = micros() - edgeUs;
+  buttonLatency.lastUs = latencyUs;
+  buttonLatency.maxUs = max(buttonLatency.maxUs, latencyUs);
+  buttonLatency.totalUs += latencyUs;
+  buttonLatency.count++;
+  log("Button action latency: " + String(latencyUs) + " us (max " + String(buttonLatency.maxUs) + " us)");
+}
+
+void onButtonPressed(uint8_t button, uint32_t edgeUs) {
+  ButtonState& b = buttons[button];
+  b.pressed = true;
+  b.pressUs = edgeUs;
+  b.longFired = false;
+
+  ButtonState& other = buttons[button ^ 1];
+  if (chordAction && other.pressed && !other.chorded && edgeUs - other.pressUs <= CHORD_WINDOW * 1000UL) {
+    b.chorded = other.chorded = true;
+    b.clickPending = other.clickPending = false;
+    log("Chord on both buttons.");
+    chordAction(button);
+  }
+}
+
+void onButtonReleased(uint8_t button, uint32_t edgeUs) {
+  ButtonState& b = buttons[button];
+  b.pressed = false;
+  b.releaseUs = edgeUs;
+
+  if (b.chorded) {
+    b.chorded = false;
+    return;
+  }
+  if (b.longFired || edgeUs - b.pressUs >= LONG_PRESS_TIME * 1000UL) {
+    return;
+  }
+  if (b.clickPending) {
+    b.clickPending = false;
+    dispatchButtonGesture(button, GESTURE_DOUBLE_CLICK, edgeUs);
+  } else if (buttonActions[button][GESTURE_DOUBLE_CLICK]) {
+    b.clickPending = true;
+  } else {
+    dispatchButtonGesture(button, GESTURE_CLICK, edgeUs);
+  }
+}
+
+void handleButtons() {
+  if (buttonsIdle()) {
+    return;
+  }
+  TraceScope trace(TRACE_HANDLE_BUTTONS);
+
+  // Drain queued edges into the per-button raw state
+  uint8_t tail = buttonEdgeTail.load(std::memory_order_relaxed);
+  while (tail != buttonEdgeHead.load(std::memory_order_acquire)) {
+    const ButtonEdge& edge = buttonEdgeQueue[tail];
+    buttons[edge.button].rawLevel = edge.level;
+    buttons[edge.button].lastEdgeUs = edge.timeUs;
+    tail = (tail + 1) & (BUTTON_QUEUE_SIZE - 1);
+    buttonEdgeTail.store(tail, std::memory_order_release);
+  }
+
+  uint32_t nowUs = micros();
+  if (buttonEdgeOverflow) {
+    buttonEdgeOverflow = false;
+    for (uint8_t i = 0; i < BUTTON_COUNT; ++i) {
+      buttons[i].rawLevel = digitalRead(BUTTON_PINS[i]);
+      buttons[i].lastEdgeUs = nowUs;
+    }
+  }
+
+  for (uint8_t i = 0; i < BUTTON_COUNT; ++i) {
+    ButtonState& b = buttons[i];
+
+    // Debounce: accept a level once it has been stable for debounceDelay
+    bool rawPressed = (b.rawLevel == LOW);
+    if (rawPressed != b.pressed && nowUs - b.lastEdgeUs > debounceDelay * 1000UL) {
+      if (rawPressed) {
+        onButtonPressed(i, b.lastEdgeUs);
+      } else {
+        onButtonReleased(i, b.lastEdgeUs);
+      }
+    }
+
+    if (b.pressed && !b.chorded) {
+      if (!b.longFired && nowUs - b.pressUs >= LONG_PRESS_TIME * 1000UL) {
+        b.longFired = true;
+        b.clickPending = false;
+        b.nextRepeatUs = nowUs + HOLD_REPEAT_INTERVAL * 1000UL;
+        dispatchButtonGesture(i, GESTURE_LONG_PRESS, b.pressUs + LONG_PRESS_TIME * 1000UL);
+      } else if (b.longFired && (int32_t)(nowUs - b.nextRepeatUs) >= 0) {
+        dispatchButtonGesture(i, GESTURE_HOLD_REPEAT, b.nextRepeatUs);
+        b.nextRepeatUs += HOLD_REPEAT_INTERVAL * 1000UL;
+      }
+    } else if (b.clickPending && !b.pressed && nowUs - b.releaseUs >= DOUBLE_CLICK_WINDOW * 1000UL) {
+      b.clickPending = false;
+      dispatchButtonGesture(i, GESTURE_CLICK, b.releaseUs + DOUBLE_CLICK_WINDOW * 1000UL);
+    }
+  }
+}
+
+void actionStartSolenoids12(uint8_t button) {
+  log("Activating Solenoids 1 & 2.");
+  // Open both valves with one register write
+  activateSolenoids((solenoidActive[0] ? 0 : 0b001) | (solenoidActive[1] ? 0 : 0b010), SOURCE_BUTTON);
+}
+
+void actionStartSolenoid3(uint8_t button) {
+  log("Activating Solenoid 3.");
+  if (!solenoidActive[2]) {
+    activateSolenoid(3, solenoid3Settings.onTime * 60000UL, SOURCE_BUTTON);
+  }
+}
+
+void actionEnsureAccessPoint(uint8_t button) {
+  log("Ensuring Access Point is active.");
+  if (!apActive) {
+    setupAccessPoint(); // Try to start AP if not active
+  } else {
+    wifiStartTime = millis(); // Reset AP timeout if button held
+    log("AP already active. Activity timer reset.");
+  }
+}
+
+void actionStopAllSolenoids(uint8_t button) {
+  log("Stopping all solenoids.");
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    pulseCancel(i);
+    if (solenoidActive[i]) {
+      deactivateSolenoid(i + 1);
+    }
+  }
+}
+
+void setupAccessPoint() {
+  if (apActive) {
+    log("WiFi Access Point is already active.");
+    wifiStartTime = millis(); // Reset AP timer on explicit call
+    return;
+  }
+  TraceScope trace(TRACE_AP_START);
+  
+  log("Setting up WiFi Access Point...");
+  
+  // Wake up WiFi if it was in forced sleep mode
+  WiFi.forceSleepWake();
+  delay(100); // Give time for WiFi to wake up
+  
+  // Ensure WiFi is in the correct mode
+  WiFi.mode(WIFI_AP);
+  
+  // Start the Access Point
+  if (!WiFi.softAP(ssid, password)) {
+    log("Failed to start Access Point! Retrying...");
+    delay(500);
+    WiFi.softAP(ssid, password);
+  }
+  
+  IPAddress myIP = WiFi.softAPIP();
+  log("AP IP address: " + myIP.toString());
+  
+  if (MDNS.begin("solenoid")) {
+    MDNS.addService("http", "tcp", 80);
+    log("MDNS responder started. Access at http://solenoid.local");
+  } else {
+    log("Error setting up MDNS responder!");
+  }
+  
+  server.on("/", HTTP_GET, handleRoot);
+  server.on("/settings", HTTP_GET, handleGetSettings);
+  server.on("/settings", HTTP_POST, handleUpdateSettings);
+  server.on("/settime", HTTP_POST, handleSetTime); // New endpoint for time sync
+  server.on("/calendar", HTTP_GET, handleGetCalendar);
+  server.on("/calendar", HTTP_POST, handleCalendarUploadDone, handleCalendarUpload); // Streamed multipart upload
+  server.on("/profile", HTTP_GET, handleProfile);
+  server.on("/power", HTTP_GET, handlePower);
+  server.on("/trace", HTTP_GET, handleTrace);
+  server.on("/soil", HTTP_GET, handleSoil);
+  server.on("/tasks", HTTP_GET, handleTasks);
+  server.on("/api/bootstrap", HTTP_GET, handleBootstrap);
+  server.on("/api/tti", HTTP_GET, handleUiTiming);
+  server.on("/api/tti", HTTP_POST, handleUiTiming);
+  server.on("/sw.js", HTTP_GET, handleServiceWorker);
+  server.on("/pulse", HTTP_GET, handleGetPulse);
+  server.on("/pulse", HTTP_POST, handlePostPulse);
+  server.on("/snapshot", HTTP_GET, handleGetSnapshot);
+  server.on("/snapshot", HTTP_POST, handleSnapshotUploadDone, handleSnapshotUpload);
+  server.on("/history", HTTP_GET, handleHistory);
+  const char* cacheHeaders[] = {"If-None-Match"};
+  server.collectHeaders(cacheHeaders, 1);
+
+  static bool activityHookAdded = false;
+  if (!activityHookAdded) {
+    // Every request keeps the governor at full speed for a while
+    server.addHook([](const String&, const String&, WiFiClient*, ESP8266WebServer::ContentTypeFunction) {
+      lastHttpActivity = millis();
+      return ESP8266WebServer::CLIENT_REQUEST_CAN_CONTINUE;
+    });
+    activityHookAdded = true;
+  }
+  server.on("/activateSolenoid1", HTTP_POST, handleActivateSolenoid1);
+  server.on("/activateSolenoid2", HTTP_POST, handleActivateSolenoid2);
+  server.on("/activateSolenoid3", HTTP_POST, handleActivateSolenoid3);
+  
+  server.begin();
+  apActive = true;
+  wifiStartTime = millis();
+  log("HTTP server started");
+}
+
+void shutdownWiFiCompletely() {
+  TraceScope trace(TRACE_AP_SHUTDOWN);
+  log("Initiating complete WiFi shutdown for power saving...");
+  
+  // Stop all active web server operations
+  server.stop();
+  log("Web server stopped");
+  
+  // Stop mDNS responder
+  if (MDNS.isRunning()) {
+    MDNS.end();
+    log("MDNS responder stopped");
+  }
+  
+  // Disconnect all connected stations and stop AP
+  WiFi.softAPdisconnect(true);
+  log("Access Point disconnected");
+  
+  // Wait a moment for clean disconnection
+  delay(100);
+  
+  // Ensure WiFi is completely off
+  WiFi.mode(WIFI_OFF);
+  WiFi.forceSleepBegin();
+  log("WiFi radio disabled and forced into sleep mode");
+  
+  // Additional power saving - turn off WiFi modem completely
+  delay(100);
+  
+  // Set flag to indicate WiFi is off
+  apActive = false;
+  
+  // Enable modem sleep mode for maximum power savings when WiFi is off
+  // This will significantly reduce power consumption
+  wifi_set_sleep_type(MODEM_SLEEP_T);
+  
+  log("Complete WiFi shutdown successful - significant power reduction achieved");
+  log("Use long press on Button 1 (D7) to reactivate WiFi when needed");
+}
+
+// Monotonic time including forced light sleep, during which micros64() stands still
+uint64_t clockRawUs() {
+  return micros64() + governorSleptUs;
+}
+
+int64_t clockNowMs() {
+  return softClockNowMs(softClock, clockRawUs());
+}
+
+// Refresh the global `now`/`timeinfo` with drift-corrected local time
+void clockUpdateLocalTime() {
+  now = (time_t)(clockNowMs() / 1000) + softClock.tzOffsetMinutes * 60;
+  gmtime_r(&now, &timeinfo);
+}
+
+// Anchor the software clock to a trusted UTC time and refine the drift estimate
+void clockSync(int64_t epochMs) {
+  int32_t oldPpb = softClock.driftPpb;
+  DriftSample sample = softClockSync(softClock, time_synced, clockRawUs(), epochMs);
+  if (sample.measured) {
+    log("Clock drift measured over " + String((uint32_t)(sample.sampleUs / 3600000000ULL)) + " h: residual " +
+        String(sample.residualPpb / 1000.0, 3) + " ppm, correction now " + String(softClock.driftPpb / 1000.0, 3) + " ppm");
+    if (softClock.driftPpb != oldPpb) {
+      saveSettings();
+    }
+  }
+  time_synced = true;
+  calendarInvalidateCursors(); // Time may have jumped
+
+  // Keep libc time in UTC for anything that still calls time()
+  struct timeval tv = { .tv_sec = (time_t)(epochMs / 1000), .tv_usec = (suseconds_t)((epochMs % 1000) * 1000) };
+  settimeofday(&tv, nullptr);
+}
+
+// Adopt the browser's UTC offset; persisted only when it changes
+void clockSetTimezone(int tzOffsetMinutes) {
+  if (tzOffsetMinutes != softClock.tzOffsetMinutes && tzOffsetMinutes >= -14 * 60 && tzOffsetMinutes <= 14 * 60) {
+    softClock.tzOffsetMinutes = tzOffsetMinutes;
+    saveSettings();
+    log("UTC offset updated from browser: " + String(tzOffsetMinutes) + " min");
+  }
+}
+
+void handleSetTime() {
+  TraceScope trace(TRACE_HTTP_SETTIME);
+  if (server.hasArg("plain")) {
+    String body = server.arg("plain");
+    DynamicJsonDocument doc(256); // Sufficient for time data
+    DeserializationError error = deserializeJson(doc, body);
+    
     if (error) {
       log("JSON Deserialization error for settime: " + String(error.c_str()));
       server.send(400, "application/json", "{\"status\":\"error\",\"message\":\"Invalid JSON for settime\"}");
       return;
     }
 
-    struct tm t_info;
-    t_info.tm_year = doc["year"].as<int>() - 1900;
-    t_info.tm_mon = doc["month"].as<int>(); // JS month 0-11 -> tm_mon 0-11
-    t_info.tm_mday = doc["day"].as<int>();
-    t_info.tm_hour = doc["hour"].as<int>();
-    t_info.tm_min = doc["minute"].as<int>();
-    t_info.tm_sec = doc["second"].as<int>();
-    t_info.tm_isdst = -1; // Auto-detect DST based on system rules (if any configured)
-
-    time_t calculated_time = mktime(&t_info);
-    
-    if (calculated_time == -1) {
-        log("Error: mktime failed to convert provided time.");
-        server.send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to interpret time data\"}");
-        return;
+    if (doc.containsKey("tzOffsetMinutes")) {
+      clockSetTimezone(doc["tzOffsetMinutes"].as<int>());
     }
 
-    struct timeval tv = { .tv_sec = calculated_time, .tv_usec = 0 };
-    if (settimeofday(&tv, nullptr) == 0) {
-        time_synced = true;
-        // Update global timeinfo to reflect the newly set time immediately
-        localtime_r(&calculated_time, &timeinfo); 
-        log("Time synchronized from browser: " + String(asctime(&timeinfo))); // asctime adds newline
-        
-        char buf[32];
-        strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &timeinfo);
-        server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"Time updated\",\"time\":\"" + String(buf) + "\"}");
+    int64_t epochMs;
+    if (doc.containsKey("epochMs")) {
+      epochMs = doc["epochMs"].as<int64_t>();
     } else {
-        log("Error: settimeofday failed.");
-        server.send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to set system time\"}");
+      // Legacy body with local calendar fields; TZ is unset so mktime() works in UTC
+      struct tm t_info;
+      t_info.tm_year = doc["year"].as<int>() - 1900;
+      t_info.tm_mon = doc["month"].as<int>(); // JS month 0-11 -> tm_mon 0-11
+      t_info.tm_mday = doc["day"].as<int>();
+      t_info.tm_hour = doc["hour"].as<int>();
+      t_info.tm_min = doc["minute"].as<int>();
+      t_info.tm_sec = doc["second"].as<int>();
+      t_info.tm_isdst = 0;
+
+      time_t calculated_time = mktime(&t_info);
+      if (calculated_time == -1) {
+          log("Error: mktime failed to convert provided time.");
+          server.send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to interpret time data\"}");
+          return;
+      }
+      epochMs = ((int64_t)calculated_time - softClock.tzOffsetMinutes * 60) * 1000;
+    }
+
+    if (epochMs < 1000000000000LL) {
+        log("Error: implausible time from browser.");
+        server.send(400, "application/json", "{\"status\":\"error\",\"message\":\"Implausible time\"}");
+        return;
     }
+
+    clockSync(epochMs);
+    // Update global timeinfo to reflect the newly set time immediately
+    clockUpdateLocalTime();
+    log("Time synchronized from browser: " + String(asctime(&timeinfo))); // asctime adds newline
+
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"Time updated\",\"time\":\"" + String(buf) +
+                "\",\"driftPpm\":" + String(softClock.driftPpb / 1000.0, 3) + "}");
   } else {
     server.send(400, "application/json", "{\"status\":\"error\",\"message\":\"No data provided for settime\"}");
   }
 }
 
 
-void handleRoot() {
-  const char* html = R"rawliteral(
+// FNV-1a of a string, evaluated at compile time
+constexpr uint32_t fnv1a(const char* text, uint32_t hash = 2166136261u) {
+  for (; *text; ++text) {
+    hash = (hash ^ (uint8_t)*text) * 16777619u;
+  }
+  return hash;
+}
+
+// Page shell served by handleRoot()
+constexpr char UI_PAGE_HTML[] = R"rawliteral(
 <!DOCTYPE html>
 <html>
 <head>
@@ -506,6 +2269,7 @@ void handleRoot() {
   <div class="container">
     <h1>Water Control</h1>
     <div id="currentTime" class="status success" style="display:none; margin-bottom:15px;"></div>
+    <div id="pulseProgress" class="status success" style="display:none; margin-bottom:15px;"></div>
     <form id="settingsForm">
       <div class="solenoid-group">
         <h2>
@@ -519,7 +2283,13 @@ void handleRoot() {
         </h2>
         <div class="setting-row">
           <label for="solenoid1OnTime">ON Time (min):</label>
-          <input type="number" id="solenoid1OnTime" name="solenoid1OnTime" min="1" step="1" value="1">
+          <input type="number" id="solenoid1OnTime" name="solenoid1OnTime" min="1" max="1440" step="1" value="1">
+        </div>
+        <div class="setting-row">
+          <label for="solenoid1PulseCycles">Cycles / soak:</label>
+          <input type="number" id="solenoid1PulseCycles" title="Pulses" min="1" max="10" step="1" value="1">
+          <input type="number" id="solenoid1SoakMin" title="Soak minutes between pulses" min="0" max="240" step="1" value="20">
+          <input type="number" id="solenoid1RampPercent" title="Ramp % per pulse" min="-50" max="50" step="5" value="0">
         </div>
         <div class="setting-row">
           <label for="solenoid1SchedTime">Schedule (HH:MM):</label>
@@ -546,7 +2316,13 @@ void handleRoot() {
         </h2>
         <div class="setting-row">
           <label for="solenoid2OnTime">ON Time (min):</label>
-          <input type="number" id="solenoid2OnTime" name="solenoid2OnTime" min="1" step="1" value="1">
+          <input type="number" id="solenoid2OnTime" name="solenoid2OnTime" min="1" max="1440" step="1" value="1">
+        </div>
+        <div class="setting-row">
+          <label for="solenoid2PulseCycles">Cycles / soak:</label>
+          <input type="number" id="solenoid2PulseCycles" title="Pulses" min="1" max="10" step="1" value="1">
+          <input type="number" id="solenoid2SoakMin" title="Soak minutes between pulses" min="0" max="240" step="1" value="20">
+          <input type="number" id="solenoid2RampPercent" title="Ramp % per pulse" min="-50" max="50" step="5" value="0">
         </div>
         <div class="setting-row">
           <label for="solenoid2SchedTime">Schedule (HH:MM):</label>
@@ -573,7 +2349,13 @@ void handleRoot() {
         </h2>
         <div class="setting-row">
           <label for="solenoid3OnTime">ON Time (min):</label>
-          <input type="number" id="solenoid3OnTime" name="solenoid3OnTime" min="1" step="1" value="1">
+          <input type="number" id="solenoid3OnTime" name="solenoid3OnTime" min="1" max="1440" step="1" value="1">
+        </div>
+        <div class="setting-row">
+          <label for="solenoid3PulseCycles">Cycles / soak:</label>
+          <input type="number" id="solenoid3PulseCycles" title="Pulses" min="1" max="10" step="1" value="1">
+          <input type="number" id="solenoid3SoakMin" title="Soak minutes between pulses" min="0" max="240" step="1" value="20">
+          <input type="number" id="solenoid3RampPercent" title="Ramp % per pulse" min="-50" max="50" step="5" value="0">
         </div>
         <div class="setting-row">
           <label for="solenoid3SchedTime">Schedule (HH:MM):</label>
@@ -589,6 +2371,24 @@ void handleRoot() {
       </div>
       
     </form>
+
+    <div class="solenoid-group">
+      <h2>Calendar</h2>
+      <div class="setting-row">
+        <input type="file" id="calendarFile" accept=".csv,.bin">
+        <button type="button" id="calendarUpload">Upload</button>
+      </div>
+      <div id="calendarInfo" class="switch-label"></div>
+    </div>
+
+    <div class="solenoid-group">
+      <h2>Configuration Snapshot</h2>
+      <div class="setting-row">
+        <a href="/snapshot" download="solenoid.wcs"><button type="button">Download</button></a>
+        <input type="file" id="snapshotFile" accept=".wcs">
+        <button type="button" id="snapshotUpload">Apply</button>
+      </div>
+    </div>
     
     <div id="statusMessage" class="status"></div>
   </div>
@@ -604,39 +2404,7 @@ void handleRoot() {
       }
     }
 
-    document.addEventListener('DOMContentLoaded', function() {
-      // Sync time with ESP
-      const now = new Date();
-      const timeData = {
-        year: now.getFullYear(),
-        month: now.getMonth(), // JS month is 0-11
-        day: now.getDate(),
-        hour: now.getHours(),
-        minute: now.getMinutes(),
-        second: now.getSeconds()
-      };
-      fetch('/settime', {
-        method: 'POST',
-        headers: { 'Content-Type': 'application/json' },
-        body: JSON.stringify(timeData)
-      })
-      .then(response => response.json())
-      .then(data => {
-        if (data.status === 'success') {
-          showStatus('Controller Time: ' + data.time, true, 'currentTime');
-        } else {
-          showStatus('Time sync failed: ' + (data.message || ''), false, 'currentTime');
-        }
-      })
-      .catch(error => {
-          console.error('Error syncing time:', error);
-          showStatus('Time sync fetch error.', false, 'currentTime');
-      });
-
-      // Fetch current settings
-      fetch('/settings')
-        .then(response => response.json())
-        .then(data => {
+    function applySettings(data) {
           document.getElementById('solenoid1OnTime').value = data.solenoid1OnTime;
           document.getElementById('solenoid1SchedTime').value = String(data.solenoid1SchedHour).padStart(2, '0') + ':' + String(data.solenoid1SchedMin).padStart(2, '0');
           document.getElementById('solenoid1SchedEnabled').checked = data.solenoid1SchedEnabled;
@@ -648,9 +2416,92 @@ void handleRoot() {
           document.getElementById('solenoid3OnTime').value = data.solenoid3OnTime;
           document.getElementById('solenoid3SchedTime').value = String(data.solenoid3SchedHour).padStart(2, '0') + ':' + String(data.solenoid3SchedMin).padStart(2, '0');
           document.getElementById('solenoid3SchedEnabled').checked = data.solenoid3SchedEnabled;
+
+          for (let i = 1; i <= 3; i++) {
+            document.getElementById(`solenoid${i}PulseCycles`).value = data[`solenoid${i}PulseCycles`];
+            document.getElementById(`solenoid${i}SoakMin`).value = data[`solenoid${i}SoakMin`];
+            document.getElementById(`solenoid${i}RampPercent`).value = data[`solenoid${i}RampPercent`];
+          }
+    }
+
+    function addPulseSettings(formData) {
+      for (let i = 1; i <= 3; i++) {
+        formData[`solenoid${i}PulseCycles`] = parseInt(document.getElementById(`solenoid${i}PulseCycles`).value);
+        formData[`solenoid${i}SoakMin`] = parseInt(document.getElementById(`solenoid${i}SoakMin`).value);
+        formData[`solenoid${i}RampPercent`] = parseInt(document.getElementById(`solenoid${i}RampPercent`).value);
+      }
+      return formData;
+    }
+
+    // Shows cycle-and-soak progress and keeps polling while a program runs
+    function showPulseProgress(pulses) {
+      const element = document.getElementById('pulseProgress');
+      const running = pulses.map((pulse, i) => {
+        if (pulse.phase === 'idle') {
+          return null;
+        }
+        const left = pulse.phase === 'waiting' ? 'waiting for supply' : Math.ceil(pulse.phaseRemainingMs / 60000) + ' min left';
+        return `S${i + 1} pulse ${pulse.cycle}/${pulse.cycles} ${pulse.phase}, ${left}`;
+      }).filter(text => text);
+      element.textContent = running.join(' | ');
+      element.style.display = running.length ? 'block' : 'none';
+      if (running.length) {
+        setTimeout(() => {
+          fetch('/pulse')
+            .then(response => response.json())
+            .then(data => showPulseProgress(data.channels))
+            .catch(error => console.error('Error fetching pulse progress:', error));
+        }, 5000);
+      }
+    }
+
+    // Reflects live valve state in the test switches; returns a summary of running valves
+    function applyValveState(valves) {
+      const running = [];
+      valves.forEach((valve, i) => {
+        document.getElementById('testSolenoid' + (i + 1)).checked = valve.active || valve.pulse.phase !== 'idle';
+        if (valve.active) {
+          running.push('S' + (i + 1) + ' ' + Math.ceil(valve.remainingMs / 60000) + ' min left');
+        }
+      });
+      return running.join(', ');
+    }
+
+    function showCalendarCounts(counts) {
+      document.getElementById('calendarInfo').textContent =
+        'Events: ' + counts.map((count, i) => 'S' + (i + 1) + '=' + count).join(', ');
+    }
+
+    if ('serviceWorker' in navigator) {
+      navigator.serviceWorker.register('/sw.js').catch(error => console.error('Service worker registration failed:', error));
+    }
+
+    document.addEventListener('DOMContentLoaded', function() {
+      // One round trip: push the browser clock, get settings, valve state and device time back
+      const now = new Date();
+      fetch('/api/bootstrap?epochMs=' + now.getTime() + '&tzOffsetMinutes=' + (-now.getTimezoneOffset()))
+        .then(response => response.json())
+        .then(data => {
+          applySettings(data.settings);
+          const running = applyValveState(data.valves);
+          showCalendarCounts(data.calendarEvents);
+          showPulseProgress(data.valves.map(valve => valve.pulse));
+
+          // Time to interactive: navigation start until live data is on screen
+          const ttiMs = Math.round(performance.now());
+          const navigation = performance.getEntriesByType('navigation')[0];
+          const cached = !!navigation && navigation.transferSize === 0;
+          if (data.timeSynced) {
+            showStatus('Controller Time: ' + data.time + (running ? ' | ' + running : '') + ` | ready in ${ttiMs} ms`, true, 'currentTime');
+          } else {
+            showStatus('Time sync failed.', false, 'currentTime');
+          }
+          if (navigator.sendBeacon) {
+            navigator.sendBeacon('/api/tti', JSON.stringify({ ttiMs: ttiMs, cached: cached }));
+          }
         })
         .catch(error => {
-          console.error('Error fetching settings:', error);
+          console.error('Error loading controller state:', error);
           showStatus('Failed to load settings.', false);
         });
       
@@ -676,6 +2527,7 @@ void handleRoot() {
           solenoid3SchedMin: parseInt(s3TimeParts[1]),
           solenoid3SchedEnabled: document.getElementById('solenoid3SchedEnabled').checked
         };
+        addPulseSettings(formData);
         
         fetch('/settings', {
           method: 'POST',
@@ -725,6 +2577,61 @@ void handleRoot() {
         };
       }
       
+      function showCalendarInfo() {
+        fetch('/calendar')
+          .then(response => response.json())
+          .then(data => showCalendarCounts(data.channels.map(c => c.events)))
+          .catch(error => console.error('Error fetching calendar:', error));
+      }
+
+      document.getElementById('calendarUpload').addEventListener('click', function() {
+        const file = document.getElementById('calendarFile').files[0];
+        if (!file) {
+          showStatus('Choose a calendar file first.', false);
+          return;
+        }
+        const form = new FormData();
+        form.append('calendar', file, file.name);
+        fetch('/calendar', { method: 'POST', body: form })
+        .then(response => response.json())
+        .then(data => {
+          if (data.status === 'success') {
+            showStatus(`Calendar stored: ${data.events} events in ${data.ms} ms`, true);
+          } else {
+            showStatus('Calendar upload failed: ' + (data.message || ''), false);
+          }
+          showCalendarInfo();
+        })
+        .catch(error => {
+          console.error('Error uploading calendar:', error);
+          showStatus('Calendar upload error.', false);
+        });
+      });
+
+      document.getElementById('snapshotUpload').addEventListener('click', function() {
+        const file = document.getElementById('snapshotFile').files[0];
+        if (!file) {
+          showStatus('Choose a snapshot file first.', false);
+          return;
+        }
+        const form = new FormData();
+        form.append('snapshot', file, file.name);
+        fetch('/snapshot', { method: 'POST', body: form })
+        .then(response => response.json())
+        .then(data => {
+          if (data.status === 'success') {
+            showStatus(`Snapshot applied: ${data.applied} fields`, true);
+            fetch('/settings').then(response => response.json()).then(applySettings);
+          } else {
+            showStatus('Snapshot rejected: ' + (data.message || ''), false);
+          }
+        })
+        .catch(error => {
+          console.error('Error uploading snapshot:', error);
+          showStatus('Snapshot upload error.', false);
+        });
+      });
+
       document.getElementById('testSolenoid1').addEventListener('change', createTestSwitchHandler(1));
       document.getElementById('testSolenoid2').addEventListener('change', createTestSwitchHandler(2));
       document.getElementById('testSolenoid3').addEventListener('change', createTestSwitchHandler(3));
@@ -751,6 +2658,7 @@ void handleRoot() {
           solenoid3SchedMin: parseInt(s3TimeParts[1]),
           solenoid3SchedEnabled: document.getElementById('solenoid3SchedEnabled').checked
         };
+        addPulseSettings(formData);
         
         fetch('/settings', {
           method: 'POST',
@@ -770,30 +2678,185 @@ void handleRoot() {
           showStatus('Auto-save error. Please check connection.', false);
         });
       }
-      
-      // Add auto-save event listeners to all input fields
-      document.getElementById('solenoid1OnTime').addEventListener('change', autoSaveSettings);
-      document.getElementById('solenoid1SchedTime').addEventListener('change', autoSaveSettings);
-      document.getElementById('solenoid1SchedEnabled').addEventListener('change', autoSaveSettings);
-      
-      document.getElementById('solenoid2OnTime').addEventListener('change', autoSaveSettings);
-      document.getElementById('solenoid2SchedTime').addEventListener('change', autoSaveSettings);
-      document.getElementById('solenoid2SchedEnabled').addEventListener('change', autoSaveSettings);
-      
-      document.getElementById('solenoid3OnTime').addEventListener('change', autoSaveSettings);
-      document.getElementById('solenoid3SchedTime').addEventListener('change', autoSaveSettings);
-      document.getElementById('solenoid3SchedEnabled').addEventListener('change', autoSaveSettings);
+      
+      // Add auto-save event listeners to all input fields
+      document.getElementById('solenoid1OnTime').addEventListener('change', autoSaveSettings);
+      document.getElementById('solenoid1SchedTime').addEventListener('change', autoSaveSettings);
+      document.getElementById('solenoid1SchedEnabled').addEventListener('change', autoSaveSettings);
+      
+      document.getElementById('solenoid2OnTime').addEventListener('change', autoSaveSettings);
+      document.getElementById('solenoid2SchedTime').addEventListener('change', autoSaveSettings);
+      document.getElementById('solenoid2SchedEnabled').addEventListener('change', autoSaveSettings);
+      
+      document.getElementById('solenoid3OnTime').addEventListener('change', autoSaveSettings);
+      document.getElementById('solenoid3SchedTime').addEventListener('change', autoSaveSettings);
+      document.getElementById('solenoid3SchedEnabled').addEventListener('change', autoSaveSettings);
+
+      for (let i = 1; i <= 3; i++) {
+        document.getElementById(`solenoid${i}PulseCycles`).addEventListener('change', autoSaveSettings);
+        document.getElementById(`solenoid${i}SoakMin`).addEventListener('change', autoSaveSettings);
+        document.getElementById(`solenoid${i}RampPercent`).addEventListener('change', autoSaveSettings);
+      }
+    });
+  </script>
+</body>
+</html>
+)rawliteral";
+
+// ETag and service worker cache version: changes exactly when the page does, so rebuilding
+// unchanged sources keeps every client's cached copy valid
+constexpr uint32_t UI_BUILD_ID = fnv1a(UI_PAGE_HTML);
+
+void handleRoot() {
+  TraceScope trace(TRACE_HTTP_ROOT);
+  // Revalidate with a 304 after a minute; browsers may show the cached copy meanwhile
+  String etag = "\"" + String(UI_BUILD_ID, HEX) + "\"";
+  server.sendHeader("ETag", etag);
+  server.sendHeader("Cache-Control", "max-age=60, stale-while-revalidate=604800");
+  if (server.header("If-None-Match") == etag) {
+    server.send(304);
+    return;
+  }
+  server.send(200, "text/html", UI_PAGE_HTML);
+}
+
+void handleGetSettings() {
+  TraceScope trace(TRACE_HTTP_GET_SETTINGS);
+  DynamicJsonDocument doc(1024); // Increased size for more fields
+  settingsToJson(doc.to<JsonObject>());
+  
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// GET /api/bootstrap?epochMs=..&tzOffsetMinutes=..: everything the page needs in one round
+// trip. The browser's clock rides along in the query and is applied before answering.
+void handleBootstrap() {
+  TraceScope trace(TRACE_HTTP_BOOTSTRAP);
+  uint32_t startUs = micros();
+  if (server.hasArg("tzOffsetMinutes")) {
+    clockSetTimezone(server.arg("tzOffsetMinutes").toInt());
+  }
+  if (server.hasArg("epochMs")) {
+    int64_t epochMs = strtoll(server.arg("epochMs").c_str(), nullptr, 10);
+    if (epochMs >= 1000000000000LL) {
+      clockSync(epochMs);
+    }
+  }
+
+  DynamicJsonDocument doc(2560);
+  settingsToJson(doc.createNestedObject("settings"));
+
+  JsonArray valves = doc.createNestedArray("valves");
+  unsigned long currentTime = millis();
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    JsonObject valve = valves.createNestedObject();
+    unsigned long elapsed = currentTime - solenoidStartTime[i];
+    valve["active"] = solenoidActive[i];
+    valve["remainingMs"] = solenoidActive[i] && elapsed < solenoidDurationMs[i] ? solenoidDurationMs[i] - elapsed : 0;
+    pulseToJson(i, valve.createNestedObject("pulse"));
+  }
+  JsonArray calendarEvents = doc.createNestedArray("calendarEvents");
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    calendarEvents.add(calendars[i].count);
+  }
+
+  doc["timeSynced"] = time_synced;
+  if (time_synced) {
+    clockUpdateLocalTime();
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    doc["time"] = buf;
+    doc["epochMs"] = clockNowMs();
+  }
+  doc["driftPpm"] = softClock.driftPpb / 1000.0;
+  doc["serverUs"] = micros() - startUs;
+
+  String response;
+  serializeJson(doc, response);
+  server.sendHeader("Cache-Control", "no-store");
+  server.send(200, "application/json", response);
+}
+
+// GET /sw.js: caches the page shell and serves it stale-while-revalidate. API calls are
+// never intercepted. Browsers only run service workers on HTTPS or localhost, so over
+// the plain-HTTP access point the ETag/Cache-Control headers on / do the caching instead.
+void handleServiceWorker() {
+  String js = "const CACHE = 'shell-" + String(UI_BUILD_ID, HEX) + "';\n";
+  js += R"rawliteral(
+self.addEventListener('install', event => {
+  event.waitUntil(caches.open(CACHE).then(cache => cache.add('/')));
+  self.skipWaiting();
+});
+self.addEventListener('activate', event => {
+  event.waitUntil(caches.keys()
+    .then(keys => Promise.all(keys.filter(key => key !== CACHE).map(key => caches.delete(key))))
+    .then(() => self.clients.claim()));
+});
+self.addEventListener('fetch', event => {
+  const url = new URL(event.request.url);
+  if (event.request.method !== 'GET' || url.pathname !== '/') {
+    return;
+  }
+  event.respondWith(caches.open(CACHE).then(cache => cache.match('/').then(cached => {
+    const update = fetch(event.request).then(response => {
+      if (response.ok) {
+        cache.put('/', response.clone());
+      }
+      return response;
     });
-  </script>
-</body>
-</html>
+    if (cached) {
+      event.waitUntil(update.catch(() => {}));
+      return cached;
+    }
+    return update;
+  })));
+});
 )rawliteral";
-  
-  server.send(200, "text/html", html);
+  server.sendHeader("Cache-Control", "no-cache");
+  server.send(200, "application/javascript", js);
 }
 
-void handleGetSettings() {
-  DynamicJsonDocument doc(512); // Increased size for more fields
+// POST /api/tti records one page load {ttiMs, cached}; GET /api/tti reports the statistics
+void handleUiTiming() {
+  TraceScope trace(TRACE_HTTP_UI_TIMING);
+  if (server.method() == HTTP_POST) {
+    DynamicJsonDocument doc(128);
+    if (!server.hasArg("plain") || deserializeJson(doc, server.arg("plain")) || !doc.containsKey("ttiMs")) {
+      server.send(400, "application/json", "{\"status\":\"error\",\"message\":\"Expected {ttiMs, cached}\"}");
+      return;
+    }
+    uint32_t ttiMs = doc["ttiMs"];
+    uiTiming.count++;
+    uiTiming.cachedCount += doc["cached"].as<bool>();
+    uiTiming.lastMs = ttiMs;
+    uiTiming.totalMs += ttiMs;
+    if (ttiMs < uiTiming.bestMs) {
+      uiTiming.bestMs = ttiMs;
+    }
+    if (ttiMs > uiTiming.worstMs) {
+      uiTiming.worstMs = ttiMs;
+    }
+    log("Page interactive in " + String(ttiMs) + " ms" + (doc["cached"].as<bool>() ? " (cached shell)" : ""));
+    server.send(200, "application/json", "{\"status\":\"success\"}");
+    return;
+  }
+
+  DynamicJsonDocument doc(256);
+  doc["count"] = uiTiming.count;
+  doc["cachedCount"] = uiTiming.cachedCount;
+  doc["lastMs"] = uiTiming.lastMs;
+  doc["bestMs"] = uiTiming.count ? uiTiming.bestMs : 0;
+  doc["worstMs"] = uiTiming.worstMs;
+  doc["avgMs"] = uiTiming.count ? uiTiming.totalMs / uiTiming.count : 0;
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// Settings fields shared by GET /settings and /api/bootstrap
+void settingsToJson(JsonObject doc) {
   doc["solenoid1OnTime"] = solenoid1Settings.onTime;
   doc["solenoid1SchedHour"] = solenoid1Settings.scheduleHour;
   doc["solenoid1SchedMin"] = solenoid1Settings.scheduleMinute;
@@ -808,16 +2871,29 @@ void handleGetSettings() {
   doc["solenoid3SchedHour"] = solenoid3Settings.scheduleHour;
   doc["solenoid3SchedMin"] = solenoid3Settings.scheduleMinute;
   doc["solenoid3SchedEnabled"] = solenoid3Settings.scheduleEnabled;
-  
-  String response;
-  serializeJson(doc, response);
-  server.send(200, "application/json", response);
+
+  doc["tzOffsetMinutes"] = softClock.tzOffsetMinutes;
+  doc["clockDriftPpm"] = softClock.driftPpb / 1000.0;
+
+  doc["soilEnabled"] = soilSettings.enabled;
+  doc["soilRawDry"] = soilSettings.rawDry;
+  doc["soilRawWet"] = soilSettings.rawWet;
+  doc["soilWetOnPercent"] = soilSettings.wetOnPercent;
+  doc["soilWetOffPercent"] = soilSettings.wetOffPercent;
+  doc["soilDryPercent"] = soilSettings.dryPercent;
+
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    doc[PULSE_CYCLES_KEYS[i]] = pulseSettings[i].cycles;
+    doc[PULSE_SOAK_KEYS[i]] = pulseSettings[i].soakMinutes;
+    doc[PULSE_RAMP_KEYS[i]] = pulseSettings[i].rampPercent;
+  }
 }
 
 void handleUpdateSettings() {
+  TraceScope trace(TRACE_HTTP_POST_SETTINGS);
   if (server.hasArg("plain")) {
     String body = server.arg("plain");
-    DynamicJsonDocument doc(512); // Increased size
+    DynamicJsonDocument doc(SETTINGS_JSON_CAPACITY);
     DeserializationError error = deserializeJson(doc, body);
     
     if (error) {
@@ -827,23 +2903,11 @@ void handleUpdateSettings() {
     }
     
     bool settingsChanged = false;
-    // Solenoid 1
-    if (doc.containsKey("solenoid1OnTime")) { solenoid1Settings.onTime = doc["solenoid1OnTime"]; settingsChanged = true; }
-    if (doc.containsKey("solenoid1SchedHour")) { solenoid1Settings.scheduleHour = doc["solenoid1SchedHour"]; settingsChanged = true; }
-    if (doc.containsKey("solenoid1SchedMin")) { solenoid1Settings.scheduleMinute = doc["solenoid1SchedMin"]; settingsChanged = true; }
-    if (doc.containsKey("solenoid1SchedEnabled")) { solenoid1Settings.scheduleEnabled = doc["solenoid1SchedEnabled"]; settingsChanged = true; }
-
-    // Solenoid 2
-    if (doc.containsKey("solenoid2OnTime")) { solenoid2Settings.onTime = doc["solenoid2OnTime"]; settingsChanged = true; }
-    if (doc.containsKey("solenoid2SchedHour")) { solenoid2Settings.scheduleHour = doc["solenoid2SchedHour"]; settingsChanged = true; }
-    if (doc.containsKey("solenoid2SchedMin")) { solenoid2Settings.scheduleMinute = doc["solenoid2SchedMin"]; settingsChanged = true; }
-    if (doc.containsKey("solenoid2SchedEnabled")) { solenoid2Settings.scheduleEnabled = doc["solenoid2SchedEnabled"]; settingsChanged = true; }
-
-    // Solenoid 3
-    if (doc.containsKey("solenoid3OnTime")) { solenoid3Settings.onTime = doc["solenoid3OnTime"]; settingsChanged = true; }
-    if (doc.containsKey("solenoid3SchedHour")) { solenoid3Settings.scheduleHour = doc["solenoid3SchedHour"]; settingsChanged = true; }
-    if (doc.containsKey("solenoid3SchedMin")) { solenoid3Settings.scheduleMinute = doc["solenoid3SchedMin"]; settingsChanged = true; }
-    if (doc.containsKey("solenoid3SchedEnabled")) { solenoid3Settings.scheduleEnabled = doc["solenoid3SchedEnabled"]; settingsChanged = true; }
+    const char* invalid = applySettingsJson(doc, settingsChanged);
+    if (invalid) {
+      server.send(400, "application/json", "{\"status\":\"error\",\"message\":\"" + String(invalid) + "\"}");
+      return;
+    }
     
     if (settingsChanged) {
         saveSettings();
@@ -857,50 +2921,457 @@ void handleUpdateSettings() {
   }
 }
 
-void handleActivateSolenoid(int solenoidNum, bool& activeFlag, unsigned long& startTime, unsigned long onTimeInMinutes) {
+void handleActivateSolenoid(int solenoidNum) {
+    TraceScope trace(TRACE_HTTP_ACTIVATE, solenoidNum);
     String solenoidName = "Solenoid " + String(solenoidNum);
-    if (!activeFlag) {
-        activateSolenoid(solenoidNum, onTimeInMinutes * 60000UL); // Duration in ms
-        activeFlag = true;
-        startTime = millis();
+    if (pulsePrograms[solenoidNum - 1].phase != PULSE_IDLE) {
+        pulseCancel(solenoidNum - 1);
+        server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"" + solenoidName + " program stopped\",\"state\":\"off\"}");
+    } else if (!solenoidActive[solenoidNum - 1]) {
+        activateSolenoid(solenoidNum, solenoidSettings[solenoidNum - 1]->onTime * 60000UL, SOURCE_WEB); // Duration in ms
         server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"" + solenoidName + " activated\",\"state\":\"on\"}");
     } else {
         deactivateSolenoid(solenoidNum);
-        activeFlag = false;
         server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"" + solenoidName + " deactivated\",\"state\":\"off\"}");
     }
 }
 
-void handleActivateSolenoid1() { handleActivateSolenoid(1, solenoid1Active, solenoid1StartTime, solenoid1Settings.onTime); }
-void handleActivateSolenoid2() { handleActivateSolenoid(2, solenoid2Active, solenoid2StartTime, solenoid2Settings.onTime); }
-void handleActivateSolenoid3() { handleActivateSolenoid(3, solenoid3Active, solenoid3StartTime, solenoid3Settings.onTime); }
+void handleActivateSolenoid1() { handleActivateSolenoid(1); }
+void handleActivateSolenoid2() { handleActivateSolenoid(2); }
+void handleActivateSolenoid3() { handleActivateSolenoid(3); }
 
-void activateSolenoid(int solenoidNum, unsigned long durationMs) {
-  int pinToActivate = -1;
-  switch(solenoidNum) {
-    case 1: pinToActivate = SOLENOID_1_PIN; break;
-    case 2: pinToActivate = SOLENOID_2_PIN; break;
-    case 3: pinToActivate = SOLENOID_3_PIN; break;
-    default: log("Invalid solenoid number for activation: " + String(solenoidNum)); return;
+void activateSolenoid(int solenoidNum, unsigned long durationMs, ActivationSource source) {
+  if (solenoidNum < 1 || solenoidNum > Valves::count) {
+    log("Invalid solenoid number for activation: " + String(solenoidNum));
+    return;
+  }
+  Valves::switchOn(1U << (solenoidNum - 1));
+  traceRecord(TRACE_INSTANT, TRACE_SOLENOID_ON, solenoidNum);
+  markSolenoidOn(solenoidNum, durationMs, source);
+}
+
+// Open every valve whose bit is set in channelMask (bit 0 = Solenoid 1) with one register write,
+// each running for its configured ON time
+void activateSolenoids(uint8_t channelMask, ActivationSource source) {
+  Valves::switchOn(channelMask);
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    if (channelMask & (1U << i)) {
+      traceRecord(TRACE_INSTANT, TRACE_SOLENOID_ON, i + 1);
+      markSolenoidOn(i + 1, solenoidSettings[i]->onTime * 60000UL, source);
+    }
   }
-  
-  digitalWrite(pinToActivate, HIGH);
-  String pinName = (pinToActivate == D2) ? "D2" : (pinToActivate == D3) ? "D3" : (pinToActivate == D4) ? "D4" : String(pinToActivate);
-  log("Solenoid " + String(solenoidNum) + " (Pin " + pinName + ") turned ON for " + String(durationMs / 60000.0, 2) + " minutes");
 }
 
 void deactivateSolenoid(int solenoidNum) {
-  int pinToDeactivate = -1;
-  switch(solenoidNum) {
-    case 1: pinToDeactivate = SOLENOID_1_PIN; break;
-    case 2: pinToDeactivate = SOLENOID_2_PIN; break;
-    case 3: pinToDeactivate = SOLENOID_3_PIN; break;
-    default: log("Invalid solenoid number for deactivation: " + String(solenoidNum)); return;
+  if (solenoidNum < 1 || solenoidNum > Valves::count) {
+    log("Invalid solenoid number for deactivation: " + String(solenoidNum));
+    return;
+  }
+  Valves::switchOff(1U << (solenoidNum - 1));
+  traceRecord(TRACE_INSTANT, TRACE_SOLENOID_OFF, solenoidNum);
+  if (solenoidActive[solenoidNum - 1]) {
+    uint32_t seconds = (millis() - solenoidStartTime[solenoidNum - 1]) / 1000;
+    if (time_synced) {
+      clockUpdateLocalTime();
+      usageRecord(solenoidNum - 1, (uint32_t)now - seconds, seconds, solenoidSource[solenoidNum - 1],
+                  solenoidCountsActivation[solenoidNum - 1]);
+    } else {
+      usageUnplacedSeconds[solenoidNum - 1] += seconds;
+    }
+  }
+  solenoidActive[solenoidNum - 1] = false;
+  log("Solenoid " + String(solenoidNum) + " (Pin " + Valves::labels[solenoidNum - 1] + ") turned OFF");
+}
+
+void markSolenoidOn(int solenoidNum, unsigned long durationMs, ActivationSource source) {
+  solenoidActive[solenoidNum - 1] = true;
+  solenoidSource[solenoidNum - 1] = source;
+  solenoidCountsActivation[solenoidNum - 1] = true;
+  solenoidStartTime[solenoidNum - 1] = millis();
+  solenoidDurationMs[solenoidNum - 1] = durationMs;
+  log("Solenoid " + String(solenoidNum) + " (Pin " + Valves::labels[solenoidNum - 1] + ") turned ON for " + String(durationMs / 60000.0, 2) + " minutes");
+}
+
+UsageBucket* usageBuckets(uint8_t tier, uint8_t channel) {
+  switch (tier) {
+    case USAGE_HOURLY: return usageHistory.hourly[channel];
+    case USAGE_DAILY:  return usageHistory.daily[channel];
+    default:           return usageHistory.weekly[channel];
+  }
+}
+
+void usageBegin() {
+  File f = LittleFS.open(USAGE_PATH, "r");
+  if (f && f.read((uint8_t*)&usageHistory, sizeof(usageHistory)) == sizeof(usageHistory) &&
+      usageHistory.magic == USAGE_MAGIC_NUMBER) {
+    log("Usage history restored.");
+  } else {
+    memset(&usageHistory, 0, sizeof(usageHistory));
+    usageHistory.magic = USAGE_MAGIC_NUMBER;
+  }
+  if (f) {
+    f.close();
+  }
+  usageLastCheckpointUs = clockRawUs();
+}
+
+// Write the tiers to flash: a temporary file renamed over the old one, so a reset
+// mid-write keeps the previous checkpoint
+void usageCheckpoint() {
+  TraceScope trace(TRACE_USAGE_CHECKPOINT);
+  File f = LittleFS.open("/usage.tmp", "w");
+  if (!f) {
+    log("Usage checkpoint failed: cannot open file.");
+    return;
+  }
+  bool written = f.write((const uint8_t*)&usageHistory, sizeof(usageHistory)) == sizeof(usageHistory);
+  f.close();
+  if (written && LittleFS.rename("/usage.tmp", USAGE_PATH)) {
+    usageDirty = false;
+  } else {
+    log("Usage checkpoint failed.");
+  }
+  usageLastCheckpointUs = clockRawUs();
+}
+
+void usageTask() {
+  if (usageDirty && clockRawUs() - usageLastCheckpointUs >= USAGE_CHECKPOINT_INTERVAL_US) {
+    usageCheckpoint();
+  }
+}
+
+// Move a tier's newest bucket forward to index, clearing the buckets it passes
+void usageAdvance(uint8_t tier, uint32_t index) {
+  const UsageTierInfo& info = USAGE_TIERS[tier];
+  uint32_t& newest = usageHistory.newestIndex[tier];
+  if (index <= newest) {
+    return;
+  }
+  uint32_t steps = index - newest < info.bucketCount ? index - newest : info.bucketCount;
+  for (uint32_t i = index - steps + 1; i <= index; ++i) {
+    for (uint8_t channel = 0; channel < SOLENOID_COUNT; ++channel) {
+      memset(&usageBuckets(tier, channel)[i % info.bucketCount], 0, sizeof(UsageBucket));
+    }
+  }
+  newest = index;
+}
+
+// Add one run that started at local time startLocal to every tier. Runs are split at
+// bucket boundaries; the activation, if it is one, counts in the bucket where the run started.
+void usageRecord(uint8_t channel, uint32_t startLocal, uint32_t seconds, ActivationSource source, bool activation) {
+  for (uint8_t tier = 0; tier < USAGE_TIER_COUNT; ++tier) {
+    const UsageTierInfo& info = USAGE_TIERS[tier];
+    uint32_t t = startLocal;
+    uint32_t remaining = seconds;
+    bool first = true;
+    while (first || remaining > 0) {
+      uint32_t index = (t + info.alignSeconds) / info.bucketSeconds;
+      uint32_t bucketEnd = (index + 1) * info.bucketSeconds - info.alignSeconds;
+      uint32_t chunk = bucketEnd - t < remaining ? bucketEnd - t : remaining;
+      usageAdvance(tier, index);
+      if (usageHistory.newestIndex[tier] - index < info.bucketCount) {
+        UsageBucket& bucket = usageBuckets(tier, channel)[index % info.bucketCount];
+        bucket.openSeconds += chunk;
+        if (first && activation && bucket.activations[source] < UINT8_MAX) {
+          bucket.activations[source]++;
+        }
+      }
+      t += chunk;
+      remaining -= chunk;
+      first = false;
+    }
+  }
+  usageDirty = true;
+}
+
+// Chunked writer for /history: formats into a small buffer and sends it when full
+struct HistoryWriter {
+  char buffer[256];
+  size_t length = 0;
+  void append(const char* format, ...) {
+    char item[80];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(item, sizeof(item), format, args);
+    va_end(args);
+    if (n < 0) {
+      return;
+    }
+    n = n < (int)sizeof(item) ? n : sizeof(item) - 1;
+    if (length + n > sizeof(buffer)) {
+      flush();
+    }
+    memcpy(buffer + length, item, n);
+    length += n;
+  }
+  void flush() {
+    if (length) {
+      server.sendContent(buffer, length);
+      length = 0;
+    }
+  }
+};
+
+// GET /history[?tier=hourly|daily|weekly][&checkpoint=1]: per tier, the local start time of
+// the oldest bucket and per valve arrays (oldest first) of minutes open and activations by
+// source. Streamed bucket by bucket, so no JSON document is built in RAM.
+void handleHistory() {
+  TraceScope trace(TRACE_HTTP_HISTORY);
+  if (server.arg("checkpoint") == "1") {
+    usageCheckpoint();
+  }
+  String only = server.arg("tier");
+  if (time_synced) {
+    clockUpdateLocalTime(); // Age the tiers up to now so empty recent buckets show up
+    for (uint8_t tier = 0; tier < USAGE_TIER_COUNT; ++tier) {
+      usageAdvance(tier, ((uint32_t)now + USAGE_TIERS[tier].alignSeconds) / USAGE_TIERS[tier].bucketSeconds);
+    }
+  }
+
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+  HistoryWriter out;
+  out.append("{\"timeSynced\":%s,\"tiers\":[", time_synced ? "true" : "false");
+  bool firstTier = true;
+  for (uint8_t tier = 0; tier < USAGE_TIER_COUNT; ++tier) {
+    const UsageTierInfo& info = USAGE_TIERS[tier];
+    if (only.length() && only != info.name) {
+      continue;
+    }
+    uint32_t newest = usageHistory.newestIndex[tier];
+    uint32_t oldest = newest >= info.bucketCount - 1U ? newest - (info.bucketCount - 1U) : 0;
+    out.append("%s{\"name\":\"%s\",\"bucketSeconds\":%u,", firstTier ? "" : ",", info.name, info.bucketSeconds);
+    out.append("\"firstStart\":%u,\"valves\":[", oldest * info.bucketSeconds - info.alignSeconds);
+    firstTier = false;
+    for (uint8_t channel = 0; channel < SOLENOID_COUNT; ++channel) {
+      const UsageBucket* buckets = usageBuckets(tier, channel);
+      out.append("%s{\"minutesOpen\":[", channel ? "," : "");
+      for (uint8_t i = 0; i < info.bucketCount; ++i) {
+        uint32_t minutes10 = (buckets[(oldest + i) % info.bucketCount].openSeconds + 3) / 6; // Tenths of a minute
+        out.append("%s%u.%u", i ? "," : "", minutes10 / 10, minutes10 % 10);
+      }
+      out.append("]");
+      for (uint8_t source = 0; source < SOURCE_COUNT; ++source) {
+        out.append(",\"%s\":[", SOURCE_NAMES[source]);
+        for (uint8_t i = 0; i < info.bucketCount; ++i) {
+          out.append("%s%u", i ? "," : "", buckets[(oldest + i) % info.bucketCount].activations[source]);
+        }
+        out.append("]");
+      }
+      out.append("}");
+    }
+    out.append("]}");
+  }
+  out.append("],\"unplacedMinutes\":[%u,%u,%u]}", usageUnplacedSeconds[0] / 60, usageUnplacedSeconds[1] / 60, usageUnplacedSeconds[2] / 60);
+  out.flush();
+  server.sendContent("");
+}
+
+struct SnapshotField {
+  uint8_t id;
+  uint8_t size;
+  void* value;
+  bool deviceSpecific; // Calibration of this unit's hardware; imported only on request
+  bool isBool;         // Decoded as != 0: any other byte than 0/1 is not a valid bool
+};
+#define SNAPSHOT_FIELD(id, var, deviceSpecific) \
+  {id, sizeof(var), &(var), deviceSpecific, std::is_same<decltype(var), bool>::value}
+const SnapshotField SNAPSHOT_FIELDS[] = {
+  SNAPSHOT_FIELD(1, solenoid1Settings.onTime, false),
+  SNAPSHOT_FIELD(2, solenoid1Settings.scheduleHour, false),
+  SNAPSHOT_FIELD(3, solenoid1Settings.scheduleMinute, false),
+  SNAPSHOT_FIELD(4, solenoid1Settings.scheduleEnabled, false),
+  SNAPSHOT_FIELD(5, pulseSettings[0].cycles, false),
+  SNAPSHOT_FIELD(6, pulseSettings[0].soakMinutes, false),
+  SNAPSHOT_FIELD(7, pulseSettings[0].rampPercent, false),
+  SNAPSHOT_FIELD(11, solenoid2Settings.onTime, false),
+  SNAPSHOT_FIELD(12, solenoid2Settings.scheduleHour, false),
+  SNAPSHOT_FIELD(13, solenoid2Settings.scheduleMinute, false),
+  SNAPSHOT_FIELD(14, solenoid2Settings.scheduleEnabled, false),
+  SNAPSHOT_FIELD(15, pulseSettings[1].cycles, false),
+  SNAPSHOT_FIELD(16, pulseSettings[1].soakMinutes, false),
+  SNAPSHOT_FIELD(17, pulseSettings[1].rampPercent, false),
+  SNAPSHOT_FIELD(21, solenoid3Settings.onTime, false),
+  SNAPSHOT_FIELD(22, solenoid3Settings.scheduleHour, false),
+  SNAPSHOT_FIELD(23, solenoid3Settings.scheduleMinute, false),
+  SNAPSHOT_FIELD(24, solenoid3Settings.scheduleEnabled, false),
+  SNAPSHOT_FIELD(25, pulseSettings[2].cycles, false),
+  SNAPSHOT_FIELD(26, pulseSettings[2].soakMinutes, false),
+  SNAPSHOT_FIELD(27, pulseSettings[2].rampPercent, false),
+  SNAPSHOT_FIELD(40, softClock.tzOffsetMinutes, false),
+  SNAPSHOT_FIELD(41, softClock.driftPpb, true),
+  SNAPSHOT_FIELD(50, soilSettings.enabled, false),
+  SNAPSHOT_FIELD(51, soilSettings.rawDry, true),
+  SNAPSHOT_FIELD(52, soilSettings.rawWet, true),
+  SNAPSHOT_FIELD(53, soilSettings.wetOnPercent, false),
+  SNAPSHOT_FIELD(54, soilSettings.wetOffPercent, false),
+  SNAPSHOT_FIELD(55, soilSettings.dryPercent, false),
+};
+#undef SNAPSHOT_FIELD
+constexpr uint8_t SNAPSHOT_FIELD_COUNT = sizeof(SNAPSHOT_FIELDS) / sizeof(SNAPSHOT_FIELDS[0]);
+constexpr size_t SNAPSHOT_HEADER_SIZE = 8;
+
+uint32_t snapshotCrc32(const uint8_t* data, size_t length) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < length; ++i) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+const SnapshotField* snapshotFindField(uint8_t id) {
+  for (uint8_t i = 0; i < SNAPSHOT_FIELD_COUNT; ++i) {
+    if (SNAPSHOT_FIELDS[i].id == id) {
+      return &SNAPSHOT_FIELDS[i];
+    }
+  }
+  return nullptr;
+}
+
+// GET /snapshot: every setting of this unit as a binary snapshot
+void handleGetSnapshot() {
+  TraceScope trace(TRACE_HTTP_GET_SNAPSHOT);
+  uint8_t data[SNAPSHOT_MAX_SIZE];
+  size_t length = SNAPSHOT_HEADER_SIZE;
+  for (uint8_t i = 0; i < SNAPSHOT_FIELD_COUNT; ++i) {
+    const SnapshotField& field = SNAPSHOT_FIELDS[i];
+    data[length++] = field.id;
+    data[length++] = field.size;
+    memcpy(data + length, field.value, field.size); // The ESP8266 is little-endian
+    length += field.size;
+  }
+  uint16_t payloadLength = length - SNAPSHOT_HEADER_SIZE;
+  memcpy(data, "WCS1", 4);
+  memcpy(data + 4, &SNAPSHOT_VERSION, sizeof(SNAPSHOT_VERSION));
+  memcpy(data + 6, &payloadLength, sizeof(payloadLength));
+  uint32_t crc = snapshotCrc32(data, length);
+  memcpy(data + length, &crc, sizeof(crc));
+  length += sizeof(crc);
+
+  server.sendHeader("Content-Disposition", "attachment; filename=\"solenoid.wcs\"");
+  server.setContentLength(length);
+  server.send(200, "application/octet-stream", "");
+  server.sendContent((const char*)data, length);
+}
+
+void handleSnapshotUpload() {
+  HTTPUpload& upload = server.upload();
+  switch (upload.status) {
+    case UPLOAD_FILE_START:
+      delete snapshotUpload;
+      snapshotUpload = new SnapshotUpload();
+      snapshotUpload->length = 0;
+      snapshotUpload->overflow = false;
+      break;
+    case UPLOAD_FILE_WRITE:
+      if (snapshotUpload) {
+        if (snapshotUpload->length + upload.currentSize > SNAPSHOT_MAX_SIZE) {
+          snapshotUpload->overflow = true;
+        } else {
+          memcpy(snapshotUpload->data + snapshotUpload->length, upload.buf, upload.currentSize);
+          snapshotUpload->length += upload.currentSize;
+        }
+      }
+      break;
+    case UPLOAD_FILE_ABORTED:
+      // The server does not call handleSnapshotUploadDone() after an abort, so free the buffer here
+      if (snapshotUpload) {
+        log("Snapshot upload aborted.");
+        delete snapshotUpload;
+        snapshotUpload = nullptr;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// Validate the whole snapshot before touching any setting; nullptr if it can be applied
+const char* snapshotVerify(const uint8_t* data, size_t length) {
+  if (length < SNAPSHOT_HEADER_SIZE + sizeof(uint32_t) || memcmp(data, "WCS1", 4) != 0) {
+    return "Not a snapshot";
+  }
+  uint16_t version;
+  uint16_t payloadLength;
+  memcpy(&version, data + 4, sizeof(version));
+  memcpy(&payloadLength, data + 6, sizeof(payloadLength));
+  if (version != SNAPSHOT_VERSION) {
+    return "Unsupported snapshot version";
+  }
+  if (SNAPSHOT_HEADER_SIZE + payloadLength + sizeof(uint32_t) != length) {
+    return "Snapshot length mismatch";
+  }
+  uint32_t crc;
+  memcpy(&crc, data + length - sizeof(crc), sizeof(crc));
+  if (crc != snapshotCrc32(data, length - sizeof(crc))) {
+    return "Snapshot CRC mismatch";
+  }
+  size_t end = SNAPSHOT_HEADER_SIZE + payloadLength;
+  for (size_t offset = SNAPSHOT_HEADER_SIZE; offset < end; offset += 2 + data[offset + 1]) {
+    if (offset + 2 > end || offset + 2 + data[offset + 1] > end) {
+      return "Truncated snapshot record";
+    }
+    const SnapshotField* field = snapshotFindField(data[offset]);
+    if (field && field->size != data[offset + 1]) {
+      return "Snapshot field has the wrong size";
+    }
+  }
+  return nullptr;
+}
+
+// POST /snapshot (multipart file): applies a snapshot atomically with one EEPROM commit.
+// Calibration of the source unit (clock drift, soil sensor) is kept unless ?calibration=1.
+void handleSnapshotUploadDone() {
+  TraceScope trace(TRACE_HTTP_POST_SNAPSHOT);
+  if (!snapshotUpload) {
+    server.send(400, "application/json", "{\"status\":\"error\",\"message\":\"No snapshot file received\"}");
+    return;
+  }
+  const uint8_t* data = snapshotUpload->data;
+  const char* error = snapshotUpload->overflow ? "Snapshot too large" : snapshotVerify(data, snapshotUpload->length);
+  if (error) {
+    delete snapshotUpload;
+    snapshotUpload = nullptr;
+    log("Snapshot rejected: " + String(error));
+    server.send(400, "application/json", "{\"status\":\"error\",\"message\":\"" + String(error) + "\"}");
+    return;
   }
 
-  digitalWrite(pinToDeactivate, LOW);
-  String pinName = (pinToDeactivate == D2) ? "D2" : (pinToDeactivate == D3) ? "D3" : (pinToDeactivate == D4) ? "D4" : String(pinToDeactivate);
-  log("Solenoid " + String(solenoidNum) + " (Pin " + pinName + ") turned OFF");
+  bool calibration = server.arg("calibration") == "1";
+  uint8_t applied = 0;
+  uint8_t skipped = 0;
+  size_t end = snapshotUpload->length - sizeof(uint32_t);
+  for (size_t offset = SNAPSHOT_HEADER_SIZE; offset < end; offset += 2 + data[offset + 1]) {
+    const SnapshotField* field = snapshotFindField(data[offset]);
+    if (!field || (field->deviceSpecific && !calibration)) {
+      skipped++;
+      continue;
+    }
+    if (field->isBool) {
+      *(bool*)field->value = data[offset + 2] != 0;
+    } else {
+      memcpy(field->value, data + offset + 2, field->size);
+    }
+    applied++;
+  }
+  delete snapshotUpload;
+  snapshotUpload = nullptr;
+
+  error = settingsCheck();
+  if (error) {
+    loadSettings(); // Back to the settings still in EEPROM
+    log("Snapshot rejected: " + String(error));
+    server.send(400, "application/json", "{\"status\":\"error\",\"message\":\"" + String(error) + "\"}");
+    return;
+  }
+  saveSettings();
+  calendarInvalidateCursors(); // The UTC offset may have changed
+  log("Snapshot applied: " + String(applied) + " fields, " + String(skipped) + " skipped.");
+  server.send(200, "application/json", "{\"status\":\"success\",\"message\":\"Snapshot applied\",\"applied\":" +
+              String(applied) + ",\"skipped\":" + String(skipped) + "}");
 }
 
 void loadSettings() {
@@ -929,6 +3400,34 @@ void loadSettings() {
     // Default settings are already in structs, so just save them.
     saveSettings();
   }
+
+  uint32_t clockMagic;
+  EEPROM.get(EEPROM_CLOCK_MAGIC_ADDR, clockMagic);
+  if (clockMagic == EEPROM_CLOCK_MAGIC_NUMBER) {
+    EEPROM.get(EEPROM_CLOCK_DRIFT_ADDR, softClock.driftPpb);
+    EEPROM.get(EEPROM_CLOCK_TZ_ADDR, softClock.tzOffsetMinutes);
+  } else {
+    log("No clock calibration in EEPROM. Using defaults.");
+    saveSettings();
+  }
+
+  uint32_t soilMagic;
+  EEPROM.get(EEPROM_SOIL_MAGIC_ADDR, soilMagic);
+  if (soilMagic == EEPROM_SOIL_MAGIC_NUMBER) {
+    EEPROM.get(EEPROM_SOIL_SETTINGS_ADDR, soilSettings);
+  } else {
+    log("No soil sensor settings in EEPROM. Using defaults.");
+    saveSettings();
+  }
+
+  uint32_t pulseMagic;
+  EEPROM.get(EEPROM_PULSE_MAGIC_ADDR, pulseMagic);
+  if (pulseMagic == EEPROM_PULSE_MAGIC_NUMBER) {
+    EEPROM.get(EEPROM_PULSE_SETTINGS_ADDR, pulseSettings);
+  } else {
+    log("No pulse programs in EEPROM. Using continuous runs.");
+    saveSettings();
+  }
   // Log current settings after loading or defaulting
   log("S1: OnTime=" + String(solenoid1Settings.onTime) + "m, Sched=" + String(solenoid1Settings.scheduleHour) + ":" + padZero(solenoid1Settings.scheduleMinute) + " En=" + solenoid1Settings.scheduleEnabled);
   log("S2: OnTime=" + String(solenoid2Settings.onTime) + "m, Sched=" + String(solenoid2Settings.scheduleHour) + ":" + padZero(solenoid2Settings.scheduleMinute) + " En=" + solenoid2Settings.scheduleEnabled);
@@ -952,14 +3451,330 @@ void saveSettings() {
   EEPROM.put(EEPROM_SOLENOID3_SCHED_HOUR_ADDR, solenoid3Settings.scheduleHour);
   EEPROM.put(EEPROM_SOLENOID3_SCHED_MIN_ADDR, solenoid3Settings.scheduleMinute);
   EEPROM.put(EEPROM_SOLENOID3_SCHED_ENABLED_ADDR, solenoid3Settings.scheduleEnabled);
+
+  EEPROM.put(EEPROM_CLOCK_MAGIC_ADDR, EEPROM_CLOCK_MAGIC_NUMBER);
+  EEPROM.put(EEPROM_CLOCK_DRIFT_ADDR, softClock.driftPpb);
+  EEPROM.put(EEPROM_CLOCK_TZ_ADDR, softClock.tzOffsetMinutes);
+
+  EEPROM.put(EEPROM_SOIL_MAGIC_ADDR, EEPROM_SOIL_MAGIC_NUMBER);
+  EEPROM.put(EEPROM_SOIL_SETTINGS_ADDR, soilSettings);
+
+  EEPROM.put(EEPROM_PULSE_MAGIC_ADDR, EEPROM_PULSE_MAGIC_NUMBER);
+  EEPROM.put(EEPROM_PULSE_SETTINGS_ADDR, pulseSettings);
   
-  if (EEPROM.commit()) {
+  bool committed;
+  {
+    TraceScope trace(TRACE_EEPROM_COMMIT);
+    committed = EEPROM.commit();
+  }
+  if (committed) {
     log("Settings saved to EEPROM.");
   } else {
     log("ERROR: Failed to save settings to EEPROM!");
   }
 }
 
+// Parse a valve number 1..SOLENOID_COUNT; 0 if invalid
+uint8_t consoleParseValve(const char* arg) {
+  long valve = arg ? strtol(arg, nullptr, 10) : 0;
+  return valve >= 1 && valve <= SOLENOID_COUNT ? valve : 0;
+}
+
+void consoleHelp(char* args);
+
+// on <valve> [minutes]
+void consoleOn(char* args) {
+  char* rest;
+  uint8_t valve = consoleParseValve(strtok_r(args, " ", &rest));
+  if (!valve) {
+    consoleOut.printf("error: valve must be 1..%u\n", SOLENOID_COUNT);
+    return;
+  }
+  const char* minutesArg = strtok_r(nullptr, " ", &rest);
+  unsigned long minutes = minutesArg ? strtoul(minutesArg, nullptr, 10) : solenoidSettings[valve - 1]->onTime;
+  if (minutes == 0 || minutes > ON_TIME_MAX_MINUTES) {
+    consoleOut.println("error: minutes must be 1..1440");
+    return;
+  }
+  if (pulseChannelBusy(valve - 1)) {
+    consoleOut.println("error: valve busy"); // off <valve> first
+    return;
+  }
+  activateSolenoid(valve, minutes * 60000UL, SOURCE_CONSOLE);
+  consoleOut.printf("ok valve %u on for %lu min\n", valve, minutes);
+}
+
+// off <valve|all>
+void consoleOff(char* args) {
+  char* rest;
+  const char* arg = strtok_r(args, " ", &rest);
+  if (arg && strcmp(arg, "all") == 0) {
+    for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+      pulseCancel(i);
+      if (solenoidActive[i]) {
+        deactivateSolenoid(i + 1);
+      }
+    }
+    consoleOut.println("ok all valves off");
+    return;
+  }
+  uint8_t valve = consoleParseValve(arg);
+  if (!valve) {
+    consoleOut.printf("error: valve must be 1..%u or all\n", SOLENOID_COUNT);
+    return;
+  }
+  pulseCancel(valve - 1);
+  if (solenoidActive[valve - 1]) {
+    deactivateSolenoid(valve);
+  }
+  consoleOut.printf("ok valve %u off\n", valve);
+}
+
+void consoleStatus(char* args) {
+  unsigned long currentTime = millis();
+  for (uint8_t i = 0; i < SOLENOID_COUNT; ++i) {
+    unsigned long elapsed = currentTime - solenoidStartTime[i];
+    unsigned long remaining = solenoidActive[i] && elapsed < solenoidDurationMs[i] ? solenoidDurationMs[i] - elapsed : 0;
+    consoleOut.printf("valve %u %s remainingMs=%lu", i + 1, solenoidActive[i] ? "on" : "off", remaining);
+    const PulseProgram& program = pulsePrograms[i];
+    if (program.phase != PULSE_IDLE) {
+      consoleOut.printf(" pulse=%s cycle=%u/%u", PULSE_PHASE_NAMES[program.phase], program.cycle + 1, program.cycles);
+    }
+    consoleOut.println();
+  }
+  if (time_synced) {
+    clockUpdateLocalTime();
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    consoleOut.printf("ok time %s\n", buf);
+  } else {
+    consoleOut.println("ok time unsynced");
+  }
+}
+
+void consoleGet(char* args) {
+  static StaticJsonDocument<1024> doc; // Kept off the cont stack
+  settingsToJson(doc.to<JsonObject>());
+  consoleOut.print("ok ");
+  serializeJson(doc, consoleOut);
+  consoleOut.println();
+}
+
+// set {"key":value,...} with the same keys as GET /settings
+void consoleSet(char* args) {
+  static StaticJsonDocument<SETTINGS_JSON_CAPACITY> doc; // Kept off the cont stack
+  DeserializationError error = deserializeJson(doc, args);
+  if (error) {
+    consoleOut.printf("error: %s\n", error.c_str());
+    return;
+  }
+  bool settingsChanged = false;
+  const char* invalid = applySettingsJson(doc, settingsChanged);
+  if (invalid) {
+    consoleOut.printf("error: %s\n", invalid);
+    return;
+  }
+  if (settingsChanged) {
+    saveSettings();
+    log("Settings updated via serial console.");
+  }
+  consoleOut.println(settingsChanged ? "ok saved" : "ok no changes");
+}
+
+// time <epochMs> [tzOffsetMinutes]
+void consoleTime(char* args) {
+  char* rest;
+  const char* epochArg = strtok_r(args, " ", &rest);
+  int64_t epochMs = epochArg ? strtoll(epochArg, nullptr, 10) : 0;
+  if (epochMs < 1000000000000LL) {
+    consoleOut.println("error: usage time <epochMs> [tzOffsetMinutes]");
+    return;
+  }
+  const char* tzArg = strtok_r(nullptr, " ", &rest);
+  if (tzArg) {
+    clockSetTimezone(atoi(tzArg));
+  }
+  clockSync(epochMs);
+  consoleStatus(nullptr);
+}
+
+void consoleMetrics(char* args) {
+  uint64_t elapsedUs = clockRawUs() - schedulerStartUs;
+  for (uint8_t i = 0; i < TASK_COUNT; ++i) {
+    const TaskStats& stats = taskStats[i];
+    consoleOut.printf("task %-12s runs=%u cpu=%.2f%% avgUs=%u maxUs=%u maxLatencyUs=%u misses=%u\n", TASKS[i].name,
+                  stats.runs, elapsedUs ? 100.0 * stats.totalUs / elapsedUs : 0.0,
+                  stats.runs ? (uint32_t)(stats.totalUs / stats.runs) : 0, stats.maxUs, stats.maxLatencyUs, stats.misses);
+  }
+  consoleOut.printf("governor state=%s cpuMHz=%u idle=%.2f%% lightSleeps=%u\n", GOVERNOR_STATE_NAMES[governorState],
+                system_get_cpu_freq(), elapsedUs ? 100.0 * governorIdleUs / elapsedUs : 0.0, governorLightSleeps);
+  consoleOut.printf("buttons presses=%u lastUs=%u maxUs=%u\n", buttonLatency.count, buttonLatency.lastUs, buttonLatency.maxUs);
+  consoleOut.printf("ok heapFree=%u driftPpm=%.3f\n", ESP.getFreeHeap(), softClock.driftPpb / 1000.0);
+}
+
+void consoleBenchReport() {
+  ConsoleBench& bench = consoleBenchRun;
+  consoleOut.printf("ok bench %s n=%u minUs=%u avgUs=%u maxUs=%u", bench.what, bench.iterations, bench.minUs,
+                (uint32_t)(bench.totalUs / bench.iterations), bench.maxUs);
+  if (strcmp(bench.what, "json") == 0) {
+    consoleOut.printf(" bytes=%u", (unsigned)bench.bytes);
+  }
+  consoleOut.println();
+}
+
+// Account one timed iteration; reports once the last one is in
+void consoleBenchAdd(uint32_t elapsedUs) {
+  ConsoleBench& bench = consoleBenchRun;
+  bench.minUs = elapsedUs < bench.minUs ? elapsedUs : bench.minUs;
+  bench.maxUs = elapsedUs > bench.maxUs ? elapsedUs : bench.maxUs;
+  bench.totalUs += elapsedUs;
+  if (bench.remaining && --bench.remaining == 0) {
+    consoleBenchReport();
+  }
+}
+
+// bench <tick|commit|json> [iterations]: min/avg/max of one operation, in microseconds
+void consoleBench(char* args) {
+  char* rest;
+  const char* what = strtok_r(args, " ", &rest);
+  const char* countArg = strtok_r(nullptr, " ", &rest);
+  uint32_t iterations = countArg ? strtoul(countArg, nullptr, 10) : 100;
+  bool tick = what && strcmp(what, "tick") == 0;
+  bool commit = what && strcmp(what, "commit") == 0;
+  bool json = what && strcmp(what, "json") == 0;
+  if (!tick && !commit && !json) {
+    consoleOut.println("error: usage bench <tick|commit|json> [iterations]");
+    return;
+  }
+  if (consoleBenchRun.remaining) {
+    consoleOut.println("error: bench tick still running");
+    return;
+  }
+  if (commit && iterations > 10) {
+    iterations = 10; // Every iteration erases and rewrites a flash sector
+  }
+  if (iterations == 0) {
+    iterations = 1;
+  }
+
+  ConsoleBench& bench = consoleBenchRun;
+  bench = {tick ? "tick" : commit ? "commit" : "json", iterations, 0, UINT32_MAX, 0, 0, 0};
+  if (tick) {
+    bench.remaining = iterations; // loop() times the next passes and reports
+    return;
+  }
+  // Static: the console task runs on the 4 KB cont stack
+  static char buffer[1024];
+  static StaticJsonDocument<1024> doc;
+  for (uint32_t i = 0; i < iterations; ++i) {
+    uint32_t startUs = micros();
+    if (commit) {
+      EEPROM.getDataPtr(); // Marks the buffer dirty so commit() really writes flash
+      EEPROM.commit();
+    } else {
+      settingsToJson(doc.to<JsonObject>());
+      bench.bytes = serializeJson(doc, buffer, sizeof(buffer));
+    }
+    consoleBenchAdd(micros() - startUs);
+    yield();
+  }
+  consoleBenchReport();
+}
+
+// pulse <valve> [stop]: run the valve's cycle-and-soak program for its ON time
+void consolePulse(char* args) {
+  char* rest;
+  uint8_t valve = consoleParseValve(strtok_r(args, " ", &rest));
+  if (!valve) {
+    consoleOut.printf("error: valve must be 1..%u\n", SOLENOID_COUNT);
+    return;
+  }
+  const char* arg = strtok_r(nullptr, " ", &rest);
+  if (arg && strcmp(arg, "stop") == 0) {
+    pulseCancel(valve - 1);
+    consoleOut.printf("ok valve %u program stopped\n", valve);
+    return;
+  }
+  pulseStart(valve - 1, solenoidSettings[valve - 1]->onTime * 60000UL, SOURCE_CONSOLE);
+  const PulseProgram& program = pulsePrograms[valve - 1];
+  consoleOut.printf("ok valve %u program %s cycles=%u\n", valve, PULSE_PHASE_NAMES[program.phase], program.cycles);
+}
+
+typedef void (*ConsoleHandler)(char* args);
+struct ConsoleCommand {
+  const char* name;
+  const char* usage;
+  ConsoleHandler run;
+};
+const ConsoleCommand CONSOLE_COMMANDS[] = {
+  {"help",    "",                             consoleHelp},
+  {"on",      "<valve> [minutes]",            consoleOn},
+  {"off",     "<valve|all>",                  consoleOff},
+  {"pulse",   "<valve> [stop]",               consolePulse},
+  {"status",  "",                             consoleStatus},
+  {"get",     "",                             consoleGet},
+  {"set",     "{\"key\":value,...}",          consoleSet},
+  {"time",    "<epochMs> [tzOffsetMinutes]",  consoleTime},
+  {"metrics", "",                             consoleMetrics},
+  {"bench",   "<tick|commit|json> [iterations]", consoleBench},
+};
+constexpr uint8_t CONSOLE_COMMAND_COUNT = sizeof(CONSOLE_COMMANDS) / sizeof(CONSOLE_COMMANDS[0]);
+
+void consoleHelp(char* args) {
+  for (uint8_t i = 0; i < CONSOLE_COMMAND_COUNT; ++i) {
+    consoleOut.printf("  %s %s\n", CONSOLE_COMMANDS[i].name, CONSOLE_COMMANDS[i].usage);
+  }
+  consoleOut.println("ok");
+}
+
+void consoleExecute(char* line) {
+  while (*line == ' ') {
+    ++line;
+  }
+  if (*line == '\0') {
+    return;
+  }
+  char* args = line;
+  while (*args && *args != ' ') {
+    ++args;
+  }
+  if (*args) {
+    *args++ = '\0';
+  }
+  for (uint8_t i = 0; i < CONSOLE_COMMAND_COUNT; ++i) {
+    if (strcmp(line, CONSOLE_COMMANDS[i].name) == 0) {
+      TraceScope trace(TRACE_CONSOLE_COMMAND, i);
+      CONSOLE_COMMANDS[i].run(args);
+      return;
+    }
+  }
+  consoleOut.printf("error: unknown command '%s', try help\n", line);
+}
+
+// Console task: send queued replies the UART has room for, then consume up to
+// CONSOLE_BYTES_PER_RUN bytes and run a command per complete line
+void consoleTask() {
+  consoleOut.drain();
+  for (uint8_t n = 0; n < CONSOLE_BYTES_PER_RUN && Serial.available() > 0; ++n) {
+    char c = Serial.read();
+    lastConsoleActivity = millis();
+    if (c == '\r' || c == '\n') {
+      if (consoleOverflow) {
+        consoleOut.println("error: line too long");
+      } else {
+        consoleLine[consoleLength] = '\0';
+        consoleExecute(consoleLine);
+      }
+      consoleLength = 0;
+      consoleOverflow = false;
+    } else if (consoleLength < CONSOLE_LINE_MAX - 1) {
+      consoleLine[consoleLength++] = c;
+    } else {
+      consoleOverflow = true;
+    }
+  }
+}
+
 String padZero(int number) {
   if (number < 10) {
     return "0" + String(number);
@@ -971,8 +3786,7 @@ void log(String message) {
   String timestamp = "[" + String(millis() / 1000.0, 3) + "s] ";
   if (time_synced) {
       char timeStr[20];
-      time(&now); // ensure `now` is current
-      localtime_r(&now, &timeinfo);
+      clockUpdateLocalTime(); // ensure `now` is current
       strftime(timeStr, sizeof(timeStr), "%H:%M:%S", &timeinfo);
       timestamp = "[" + String(timeStr) + "] ";
   }
@@ -0,0 +1,179 @@
+// Cycle-and-soak pulse engine
+// A channel with more than one cycle delivers its ON time as N pulses separated by soak
+// periods, so the water soaks in instead of running off. Pulse k gets weight
+// 100 + k * rampPercent (at least 10). Phase boundaries are absolute deadlines on the raw
+// clock, each derived from the previous nominal boundary, so loop latency never adds up
+// over a long program. At most pulseSupplyValves valves are open at once; a channel
+// whose soak has ended waits for the supply and the earliest-released channel goes first,
+// so one zone's pulses fill the other zones' soak periods.
+//
+// The engine has no Arduino dependency. The clock, the valves and the logging are reached
+// through the hooks declared below, which main.cpp implements on the real hardware and
+// test/test_pulse and tools/pulse_sim.cpp implement on the host.
+#pragma once
+
+#include <stdint.h>
+
+constexpr uint8_t PULSE_CHANNELS = 3;        // One program per valve
+constexpr uint8_t PULSE_MAX_CYCLES = 10;
+const uint32_t PULSE_MIN_MS = 30000;         // Shorter pulses barely wet the zone
+const uint32_t PULSE_CANCEL_SLACK_MS = 50;   // A valve closed earlier than this before its deadline was stopped by hand
+
+struct PulseSettings {
+  uint8_t cycles;      // 1 = one continuous run
+  uint8_t soakMinutes;
+  int8_t rampPercent;  // Weight change per pulse relative to the first
+};
+
+enum PulsePhase : uint8_t { PULSE_IDLE, PULSE_ON, PULSE_SOAK, PULSE_WAITING };
+const char* const PULSE_PHASE_NAMES[] = {"idle", "on", "soak", "waiting"};
+struct PulseProgram {
+  PulsePhase phase;
+  uint8_t cycle;            // Current pulse, 0-based
+  uint8_t cycles;
+  uint8_t source;           // Who started the program; opaque to the engine, passed back through the hooks
+  uint32_t pulseMs[PULSE_MAX_CYCLES];
+  uint32_t soakMs;
+  uint64_t deadlineMs;      // End of the ON or SOAK phase; release time while WAITING
+  uint64_t startedMs;
+  uint32_t waitedMs;        // Time spent waiting for the supply
+  uint32_t worstLatenessMs; // Worst pulse start after its release
+};
+
+// Program events the firmware logs
+enum PulseNotice : uint8_t { PULSE_NOTICE_BUSY, PULSE_NOTICE_STARTED, PULSE_NOTICE_STOPPED, PULSE_NOTICE_DONE };
+
+inline PulseSettings pulseSettings[PULSE_CHANNELS] = {{1, 20, 0}, {1, 20, 0}, {1, 20, 0}};
+inline PulseProgram pulsePrograms[PULSE_CHANNELS];
+inline uint8_t pulseSupplyValves = PULSE_CHANNELS; // Valves the supply can feed at once; lower for a weak supply
+
+// Hooks
+uint64_t pulseNowMs();                                     // Monotonic ms, including light sleep
+bool pulseValveIsOpen(uint8_t channel);                    // False once the valve timed out or was closed
+void pulseValveOpen(uint8_t channel, uint32_t durationMs); // Open; the valve layer closes it after durationMs.
+                                                           // pulsePrograms[channel].cycle is the pulse being opened.
+void pulseValveClose(uint8_t channel);
+void pulsePhaseChanged(uint8_t channel);
+void pulseNotify(uint8_t channel, PulseNotice notice);
+
+void pulseUpdate();
+
+inline void pulseSetPhase(uint8_t channel, PulsePhase phase) {
+  pulsePrograms[channel].phase = phase;
+  pulsePhaseChanged(channel);
+}
+
+// Split totalMs into the channel's pulses; returns the number of pulses
+inline uint8_t pulseSplit(const PulseSettings& settings, uint32_t totalMs, uint32_t* pulseMs) {
+  uint8_t cycles = settings.cycles < 1 ? 1 : settings.cycles > PULSE_MAX_CYCLES ? PULSE_MAX_CYCLES : settings.cycles;
+  while (cycles > 1 && totalMs / cycles < PULSE_MIN_MS) {
+    cycles--; // Fewer, longer pulses rather than ones too short to matter
+  }
+
+  int32_t weights[PULSE_MAX_CYCLES];
+  int32_t weightSum = 0;
+  for (uint8_t k = 0; k < cycles; ++k) {
+    int32_t weight = (int32_t)100 + k * settings.rampPercent;
+    weights[k] = weight < 10 ? 10 : weight;
+    weightSum += weights[k];
+  }
+  uint32_t assignedMs = 0;
+  for (uint8_t k = 0; k < cycles; ++k) {
+    pulseMs[k] = k + 1 < cycles ? (uint64_t)totalMs * weights[k] / weightSum : totalMs - assignedMs;
+    assignedMs += pulseMs[k];
+  }
+  return cycles;
+}
+
+// Start the channel's program delivering totalMs of water, tagged with source. With one
+// cycle this is a plain run; the supply limit still applies.
+inline void pulseStart(uint8_t channel, uint32_t totalMs, uint8_t source) {
+  PulseProgram& program = pulsePrograms[channel];
+  if (program.phase != PULSE_IDLE) {
+    pulseNotify(channel, PULSE_NOTICE_BUSY);
+    return;
+  }
+  program.cycles = pulseSplit(pulseSettings[channel], totalMs, program.pulseMs);
+  program.cycle = 0;
+  program.source = source;
+  program.soakMs = pulseSettings[channel].soakMinutes * 60000UL;
+  program.startedMs = pulseNowMs();
+  program.deadlineMs = program.startedMs; // Released now
+  program.waitedMs = 0;
+  program.worstLatenessMs = 0;
+  pulseSetPhase(channel, PULSE_WAITING);
+  pulseNotify(channel, PULSE_NOTICE_STARTED);
+  pulseUpdate(); // Opens the valve now if the supply is free
+}
+
+// True while the channel's valve is open or its program is running (including soak and
+// supply waits); another run on the channel would fight the program for the valve
+inline bool pulseChannelBusy(uint8_t channel) {
+  return pulsePrograms[channel].phase != PULSE_IDLE || pulseValveIsOpen(channel);
+}
+
+inline void pulseCancel(uint8_t channel) {
+  if (pulsePrograms[channel].phase == PULSE_IDLE) {
+    return;
+  }
+  pulseSetPhase(channel, PULSE_IDLE);
+  if (pulseValveIsOpen(channel)) {
+    pulseValveClose(channel);
+  }
+  pulseNotify(channel, PULSE_NOTICE_STOPPED);
+}
+
+// Advance every program whose deadline has passed, then hand free supply to waiting
+// programs in order of release. Runs right after the valve timeouts.
+inline void pulseUpdate() {
+  uint64_t nowMs = pulseNowMs();
+  uint8_t openValves = 0;
+  for (uint8_t i = 0; i < PULSE_CHANNELS; ++i) {
+    openValves += pulseValveIsOpen(i);
+  }
+
+  uint8_t releasedNow = 0; // Soak ended in this pass: a start now is late only by loop latency
+  for (uint8_t i = 0; i < PULSE_CHANNELS; ++i) {
+    PulseProgram& program = pulsePrograms[i];
+    if (program.phase == PULSE_ON && !pulseValveIsOpen(i)) {
+      if (nowMs + PULSE_CANCEL_SLACK_MS < program.deadlineMs) {
+        pulseSetPhase(i, PULSE_IDLE);
+        pulseNotify(i, PULSE_NOTICE_STOPPED);
+      } else if (++program.cycle >= program.cycles) {
+        pulseSetPhase(i, PULSE_IDLE);
+        pulseNotify(i, PULSE_NOTICE_DONE);
+      } else {
+        program.deadlineMs += program.soakMs; // From the nominal end of the pulse
+        pulseSetPhase(i, PULSE_SOAK);
+      }
+    }
+    if (program.phase == PULSE_SOAK && nowMs >= program.deadlineMs) {
+      pulseSetPhase(i, PULSE_WAITING);
+      releasedNow |= 1U << i;
+    }
+  }
+
+  while (openValves < pulseSupplyValves) {
+    int8_t next = -1;
+    for (uint8_t i = 0; i < PULSE_CHANNELS; ++i) {
+      const PulseProgram& program = pulsePrograms[i];
+      if (program.phase == PULSE_WAITING && !pulseValveIsOpen(i) &&
+          (next < 0 || program.deadlineMs < pulsePrograms[next].deadlineMs)) {
+        next = i;
+      }
+    }
+    if (next < 0) {
+      break;
+    }
+    PulseProgram& program = pulsePrograms[next];
+    uint32_t latenessMs = nowMs - program.deadlineMs;
+    program.waitedMs += latenessMs;
+    program.worstLatenessMs = latenessMs > program.worstLatenessMs ? latenessMs : program.worstLatenessMs;
+    // Without a supply wait the pulse is timed from its release, so the latency of this pass
+    // shortens the next soak instead of shifting every later boundary
+    program.deadlineMs = (releasedNow & (1U << next) ? program.deadlineMs : nowMs) + program.pulseMs[program.cycle];
+    pulseSetPhase(next, PULSE_ON);
+    pulseValveOpen(next, program.pulseMs[program.cycle]);
+    openValves++;
+  }
+}
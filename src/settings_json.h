@@ -0,0 +1,132 @@
+// Settings JSON for POST /settings and the console set command
+// The key mapping, range checks and document size, with no dependency beyond ArduinoJson so
+// the exact payload the web UI posts can be replayed in test/test_settings. main.cpp owns
+// the settings variables declared below and their EEPROM storage (loadSettings()).
+#pragma once
+
+#include <stdint.h>
+#include <ArduinoJson.h>
+#include "clock_math.h"
+#include "soil_filter.h"
+#include "pulse_engine.h"
+
+struct SolenoidSettings {
+  unsigned long onTime; // in minutes
+  uint8_t scheduleHour;   // 0-23
+  uint8_t scheduleMinute; // 0-59
+  bool scheduleEnabled;
+};
+
+const unsigned long ON_TIME_MAX_MINUTES = 24 * 60; // Keeps onTime * 60000 within 32 bits
+
+constexpr uint8_t PULSE_MAX_SOAK_MINUTES = 240;
+constexpr int8_t PULSE_MAX_RAMP_PERCENT = 50;
+
+// Per-channel pulse program keys in the settings JSON
+const char* const PULSE_CYCLES_KEYS[] = {"solenoid1PulseCycles", "solenoid2PulseCycles", "solenoid3PulseCycles"};
+const char* const PULSE_SOAK_KEYS[] = {"solenoid1SoakMin", "solenoid2SoakMin", "solenoid3SoakMin"};
+const char* const PULSE_RAMP_KEYS[] = {"solenoid1RampPercent", "solenoid2RampPercent", "solenoid3RampPercent"};
+
+// Every key applySettingsJson() reads: 4 + 3 pulse keys per valve, the UTC offset and 6 soil
+// fields. deserializeJson() copies the key strings of a String body into the document, so
+// each key needs its slot plus up to SETTINGS_JSON_KEY_BYTES for the name.
+constexpr size_t SETTINGS_JSON_KEYS = 7 * PULSE_CHANNELS + 1 + 6;
+constexpr size_t SETTINGS_JSON_KEY_BYTES = 22; // "solenoid1SchedEnabled" and its terminator
+constexpr size_t SETTINGS_JSON_CAPACITY = JSON_OBJECT_SIZE(SETTINGS_JSON_KEYS) + SETTINGS_JSON_KEYS * SETTINGS_JSON_KEY_BYTES;
+
+extern SolenoidSettings solenoid1Settings;
+extern SolenoidSettings solenoid2Settings;
+extern SolenoidSettings solenoid3Settings;
+extern SolenoidSettings* const solenoidSettings[PULSE_CHANNELS];
+extern SoftClock softClock;
+extern SoilSettings soilSettings;
+
+void loadSettings(); // Restores the saved settings after a rejected update
+
+inline int settingsClamp(int value, int low, int high) {
+  return value < low ? low : value > high ? high : value;
+}
+
+// Range and cross-field validation of the settings in RAM; nullptr if they are valid.
+// POST /settings, console set and snapshot import all go through here.
+inline const char* settingsCheck() {
+  for (uint8_t i = 0; i < PULSE_CHANNELS; ++i) {
+    const SolenoidSettings& settings = *solenoidSettings[i];
+    if (settings.onTime < 1 || settings.onTime > ON_TIME_MAX_MINUTES) {
+      return "ON time must be 1..1440 minutes";
+    }
+    if (settings.scheduleHour > 23 || settings.scheduleMinute > 59) {
+      return "Schedule time out of range";
+    }
+    if (pulseSettings[i].cycles < 1 || pulseSettings[i].cycles > PULSE_MAX_CYCLES) {
+      return "Pulse cycles must be 1..10";
+    }
+    if (pulseSettings[i].soakMinutes > PULSE_MAX_SOAK_MINUTES) {
+      return "Soak must be 0..240 minutes";
+    }
+    if (pulseSettings[i].rampPercent < -PULSE_MAX_RAMP_PERCENT || pulseSettings[i].rampPercent > PULSE_MAX_RAMP_PERCENT) {
+      return "Ramp must be -50..50 percent";
+    }
+  }
+  if (softClock.tzOffsetMinutes < -14 * 60 || softClock.tzOffsetMinutes > 14 * 60) {
+    return "UTC offset out of range";
+  }
+  if (softClock.driftPpb < -DRIFT_LIMIT_PPB || softClock.driftPpb > DRIFT_LIMIT_PPB) {
+    return "Clock drift out of range";
+  }
+  if (soilSettings.rawDry > 1023 || soilSettings.rawWet > 1023 || soilSettings.wetOnPercent > 100) {
+    return "Soil calibration must be 0..1023 and thresholds 0..100";
+  }
+  if (soilSettings.wetOffPercent > soilSettings.wetOnPercent || soilSettings.dryPercent >= soilSettings.wetOnPercent) {
+    return "Soil thresholds must satisfy dry < wetOn and wetOff <= wetOn";
+  }
+  return nullptr;
+}
+
+// Apply the settings fields present in doc (same keys as GET /settings). Returns an error
+// message, with the previous settings restored, if the result is invalid; nothing is saved.
+inline const char* applySettingsJson(JsonDocument& doc, bool& settingsChanged) {
+  // Solenoid 1
+  if (doc.containsKey("solenoid1OnTime")) { solenoid1Settings.onTime = doc["solenoid1OnTime"]; settingsChanged = true; }
+  if (doc.containsKey("solenoid1SchedHour")) { solenoid1Settings.scheduleHour = doc["solenoid1SchedHour"]; settingsChanged = true; }
+  if (doc.containsKey("solenoid1SchedMin")) { solenoid1Settings.scheduleMinute = doc["solenoid1SchedMin"]; settingsChanged = true; }
+  if (doc.containsKey("solenoid1SchedEnabled")) { solenoid1Settings.scheduleEnabled = doc["solenoid1SchedEnabled"]; settingsChanged = true; }
+
+  // Solenoid 2
+  if (doc.containsKey("solenoid2OnTime")) { solenoid2Settings.onTime = doc["solenoid2OnTime"]; settingsChanged = true; }
+  if (doc.containsKey("solenoid2SchedHour")) { solenoid2Settings.scheduleHour = doc["solenoid2SchedHour"]; settingsChanged = true; }
+  if (doc.containsKey("solenoid2SchedMin")) { solenoid2Settings.scheduleMinute = doc["solenoid2SchedMin"]; settingsChanged = true; }
+  if (doc.containsKey("solenoid2SchedEnabled")) { solenoid2Settings.scheduleEnabled = doc["solenoid2SchedEnabled"]; settingsChanged = true; }
+
+  // Solenoid 3
+  if (doc.containsKey("solenoid3OnTime")) { solenoid3Settings.onTime = doc["solenoid3OnTime"]; settingsChanged = true; }
+  if (doc.containsKey("solenoid3SchedHour")) { solenoid3Settings.scheduleHour = doc["solenoid3SchedHour"]; settingsChanged = true; }
+  if (doc.containsKey("solenoid3SchedMin")) { solenoid3Settings.scheduleMinute = doc["solenoid3SchedMin"]; settingsChanged = true; }
+  if (doc.containsKey("solenoid3SchedEnabled")) { solenoid3Settings.scheduleEnabled = doc["solenoid3SchedEnabled"]; settingsChanged = true; }
+
+  // Clock
+  if (doc.containsKey("tzOffsetMinutes")) { softClock.tzOffsetMinutes = doc["tzOffsetMinutes"]; settingsChanged = true; }
+
+  // Soil sensor
+  if (doc.containsKey("soilEnabled")) { soilSettings.enabled = doc["soilEnabled"]; settingsChanged = true; }
+  if (doc.containsKey("soilRawDry")) { soilSettings.rawDry = doc["soilRawDry"]; settingsChanged = true; }
+  if (doc.containsKey("soilRawWet")) { soilSettings.rawWet = doc["soilRawWet"]; settingsChanged = true; }
+  if (doc.containsKey("soilWetOnPercent")) { soilSettings.wetOnPercent = doc["soilWetOnPercent"]; settingsChanged = true; }
+  if (doc.containsKey("soilWetOffPercent")) { soilSettings.wetOffPercent = doc["soilWetOffPercent"]; settingsChanged = true; }
+  if (doc.containsKey("soilDryPercent")) { soilSettings.dryPercent = doc["soilDryPercent"]; settingsChanged = true; }
+  // Pulse programs
+  for (uint8_t i = 0; i < PULSE_CHANNELS; ++i) {
+    // Saturate to the field type so settingsCheck() sees, and rejects, out-of-range values
+    if (doc.containsKey(PULSE_CYCLES_KEYS[i])) { pulseSettings[i].cycles = settingsClamp(doc[PULSE_CYCLES_KEYS[i]].as<int>(), 0, 255); settingsChanged = true; }
+    if (doc.containsKey(PULSE_SOAK_KEYS[i])) { pulseSettings[i].soakMinutes = settingsClamp(doc[PULSE_SOAK_KEYS[i]].as<int>(), 0, 255); settingsChanged = true; }
+    if (doc.containsKey(PULSE_RAMP_KEYS[i])) { pulseSettings[i].rampPercent = settingsClamp(doc[PULSE_RAMP_KEYS[i]].as<int>(), -128, 127); settingsChanged = true; }
+  }
+
+  const char* invalid = settingsCheck();
+  if (invalid) {
+    loadSettings(); // Discard the partial update
+    settingsChanged = false;
+  }
+  return invalid;
+}
+
@@ -0,0 +1,101 @@
+// Soil moisture filter chain
+// Decimation, running median, calibration and hysteresis for one sensor, kept free of
+// Arduino so the stages can be replayed against A0 traces in test/test_soil. main.cpp owns
+// the ADC pacing, the multiplexer and the per-sensor filter state.
+#pragma once
+
+#include <stdint.h>
+
+constexpr uint8_t SOIL_OVERSAMPLE = 16;       // Reads per decimated sample
+constexpr uint8_t SOIL_DECIMATION_SHIFT = 2;  // 16 x 10-bit summed, >> 2 = 12-bit
+constexpr uint8_t SOIL_MEDIAN_WINDOW = 5;     // Decimated samples in the median
+
+struct SoilSettings {
+  bool enabled;
+  uint16_t rawDry;        // 10-bit ADC reading in dry soil
+  uint16_t rawWet;        // 10-bit ADC reading in saturated soil
+  uint8_t wetOnPercent;   // Becomes wet at or above this moisture
+  uint8_t wetOffPercent;  // Stops being wet below this moisture
+  uint8_t dryPercent;     // At or below this moisture schedules run in full
+};
+
+struct SoilFilter {
+  uint32_t accumulator;
+  uint8_t accumulated;
+  uint16_t history[SOIL_MEDIAN_WINDOW]; // Decimated samples, 12-bit
+  uint8_t historyCount;
+  uint8_t historyNext;
+  uint16_t filtered;                    // Median, 12-bit
+  uint8_t percent;
+  bool wet;
+  bool valid;
+};
+
+// Decimation: add one 10-bit read; returns true and sets `decimated` every SOIL_OVERSAMPLE reads
+inline bool soilDecimate(SoilFilter& f, uint16_t raw, uint16_t& decimated) {
+  f.accumulator += raw;
+  if (++f.accumulated < SOIL_OVERSAMPLE) {
+    return false;
+  }
+  decimated = f.accumulator >> SOIL_DECIMATION_SHIFT;
+  f.accumulator = 0;
+  f.accumulated = 0;
+  return true;
+}
+
+// Median: add a decimated sample to the window and return the median of the window
+inline uint16_t soilMedian(SoilFilter& f, uint16_t decimated) {
+  f.history[f.historyNext] = decimated;
+  f.historyNext = (f.historyNext + 1) % SOIL_MEDIAN_WINDOW;
+  if (f.historyCount < SOIL_MEDIAN_WINDOW) {
+    f.historyCount++;
+  }
+  uint16_t sorted[SOIL_MEDIAN_WINDOW];
+  for (uint8_t i = 0; i < f.historyCount; ++i) {
+    uint16_t value = f.history[i];
+    uint8_t j = i;
+    for (; j > 0 && sorted[j - 1] > value; --j) {
+      sorted[j] = sorted[j - 1];
+    }
+    sorted[j] = value;
+  }
+  return sorted[f.historyCount / 2];
+}
+
+// Calibration: 12-bit filtered value to 0-100 %. The calibration points are 10-bit; works
+// for sensors that read lower (capacitive) or higher (resistive) when wet.
+inline uint8_t soilPercent(const SoilSettings& settings, uint16_t filtered) {
+  int32_t dry = (int32_t)settings.rawDry << SOIL_DECIMATION_SHIFT;
+  int32_t wet = (int32_t)settings.rawWet << SOIL_DECIMATION_SHIFT;
+  int32_t percent = dry == wet ? 0 : (dry - (int32_t)filtered) * 100 / (dry - wet);
+  return percent < 0 ? 0 : percent > 100 ? 100 : (uint8_t)percent;
+}
+
+// Hysteresis: wet from wetOnPercent up, dry again only below wetOffPercent
+inline bool soilHysteresis(const SoilSettings& settings, bool wet, uint8_t percent) {
+  if (!wet && percent >= settings.wetOnPercent) {
+    return true;
+  }
+  if (wet && percent < settings.wetOffPercent) {
+    return false;
+  }
+  return wet;
+}
+
+// Feed one decimated sample through the median, calibration and hysteresis stages
+inline void soilFilterUpdate(SoilFilter& f, const SoilSettings& settings, uint16_t decimated) {
+  f.filtered = soilMedian(f, decimated);
+  f.percent = soilPercent(settings, f.filtered);
+  f.wet = soilHysteresis(settings, f.wet, f.percent);
+  f.valid = true;
+}
+
+// Feed one 10-bit read through the whole chain; returns true when the filter output changed
+inline bool soilFilterRead(SoilFilter& f, const SoilSettings& settings, uint16_t raw) {
+  uint16_t decimated;
+  if (!soilDecimate(f, raw, decimated)) {
+    return false;
+  }
+  soilFilterUpdate(f, settings, decimated);
+  return true;
+}
@@ -0,0 +1,128 @@
+// Host tests for the drift-compensated software clock (src/clock_math.h)
+// Run with: pio test -e native -f test_clock
+#include <unity.h>
+#include "clock_math.h"
+
+const uint64_t HOUR_US = 3600ULL * 1000000;
+const uint64_t DAY_US = 24 * HOUR_US;
+const int64_t START_EPOCH_MS = 1750000000000LL;
+
+// A controller whose oscillator runs off by trueDriftPpb, synced from a browser whose
+// clock is off by up to +-jitterMs per sync
+struct SimulatedUnit {
+  int64_t trueDriftPpb;
+  int64_t jitterMs;
+  uint32_t seed;
+  SoftClock clock;
+  bool synced;
+
+  // Raw microseconds the oscillator has counted after trueUs of real time
+  uint64_t rawAt(uint64_t trueUs) const {
+    return (uint64_t)((__int128)trueUs * 1000000000 / (1000000000 + trueDriftPpb));
+  }
+  int64_t nextJitterMs() {
+    seed = seed * 1664525 + 1013904223;
+    return jitterMs ? (int64_t)(seed >> 8) % (2 * jitterMs + 1) - jitterMs : 0;
+  }
+  void syncAt(uint64_t trueUs) {
+    softClockSync(clock, synced, rawAt(trueUs), START_EPOCH_MS + (int64_t)(trueUs / 1000) + nextJitterMs());
+    synced = true;
+  }
+  int64_t errorMsAt(uint64_t trueUs) const {
+    return softClockNowMs(clock, rawAt(trueUs)) - (START_EPOCH_MS + (int64_t)(trueUs / 1000));
+  }
+};
+
+SimulatedUnit makeUnit(int64_t trueDriftPpb, int64_t jitterMs) {
+  SimulatedUnit unit = {trueDriftPpb, jitterMs, 12345, {0, 0, 0, 0, 0, 0}, false};
+  return unit;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_first_sync_only_anchors() {
+  SimulatedUnit unit = makeUnit(40000, 0);
+  unit.syncAt(HOUR_US);
+  TEST_ASSERT_EQUAL_INT32(0, unit.clock.driftPpb);
+  TEST_ASSERT_INT64_WITHIN(1, 0, unit.errorMsAt(HOUR_US));
+}
+
+void test_short_samples_are_ignored() {
+  SimulatedUnit unit = makeUnit(40000, 0);
+  unit.syncAt(0);
+  for (int i = 1; i <= 5; ++i) {
+    unit.syncAt(i * HOUR_US); // Each sync is less than DRIFT_MIN_SAMPLE_US after the anchor
+  }
+  TEST_ASSERT_EQUAL_INT32(0, unit.clock.driftPpb);
+  unit.syncAt(7 * HOUR_US);
+  TEST_ASSERT_GREATER_THAN(0, unit.clock.driftPpb);
+}
+
+// Daily syncs with a second of browser jitter: the estimate settles on the true drift
+void test_drift_converges_with_daily_syncs() {
+  const int64_t drifts[] = {45000, -30000, 120000};
+  for (int64_t trueDrift : drifts) {
+    SimulatedUnit unit = makeUnit(trueDrift, 500);
+    for (int day = 0; day <= 28; ++day) {
+      unit.syncAt(day * DAY_US);
+    }
+    // 1 s over a day is 11.6 ppm; the weighting keeps the estimate well inside that
+    TEST_ASSERT_INT32_WITHIN(3000, trueDrift, unit.clock.driftPpb);
+  }
+}
+
+// After calibration the clock free-runs for weeks without syncs and stays close
+void test_extrapolation_stays_bounded_over_weeks() {
+  SimulatedUnit unit = makeUnit(50000, 500);
+  uint64_t t = 0;
+  for (int day = 0; day <= 28; ++day, t = day * DAY_US) {
+    unit.syncAt(t);
+  }
+  uint64_t lastSync = 28 * DAY_US;
+  int64_t worstMs = 0;
+  for (uint64_t dt = 0; dt <= 21 * DAY_US; dt += HOUR_US) {
+    int64_t error = unit.errorMsAt(lastSync + dt);
+    worstMs = error < 0 ? (-error > worstMs ? -error : worstMs) : (error > worstMs ? error : worstMs);
+  }
+  // Uncorrected, 50 ppm is 91 s over three weeks; calibrated it stays within a few seconds
+  TEST_ASSERT_LESS_OR_EQUAL(6000, worstMs);
+
+  SimulatedUnit uncorrected = makeUnit(50000, 0);
+  uncorrected.syncAt(0);
+  TEST_ASSERT_LESS_THAN(-90000, uncorrected.errorMsAt(21 * DAY_US));
+}
+
+// Irregular syncs (a few hours to several days apart) still converge
+void test_drift_converges_with_irregular_syncs() {
+  SimulatedUnit unit = makeUnit(-65000, 800);
+  const uint32_t gapsHours[] = {7, 30, 9, 100, 12, 48, 200, 6, 72, 26, 150, 8, 96, 40};
+  uint64_t t = 0;
+  unit.syncAt(t);
+  for (int round = 0; round < 3; ++round) {
+    for (uint32_t gap : gapsHours) {
+      t += gap * HOUR_US;
+      unit.syncAt(t);
+    }
+  }
+  TEST_ASSERT_INT32_WITHIN(3000, -65000, unit.clock.driftPpb);
+}
+
+void test_drift_is_clamped() {
+  SimulatedUnit unit = makeUnit(900000, 0); // Not a real crystal: clamps instead of wrapping
+  for (int day = 0; day <= 10; ++day) {
+    unit.syncAt(day * DAY_US);
+  }
+  TEST_ASSERT_EQUAL_INT32(DRIFT_LIMIT_PPB, unit.clock.driftPpb);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_sync_only_anchors);
+  RUN_TEST(test_short_samples_are_ignored);
+  RUN_TEST(test_drift_converges_with_daily_syncs);
+  RUN_TEST(test_extrapolation_stays_bounded_over_weeks);
+  RUN_TEST(test_drift_converges_with_irregular_syncs);
+  RUN_TEST(test_drift_is_clamped);
+  return UNITY_END();
+}
@@ -0,0 +1,244 @@
+// Host tests for the cycle-and-soak engine (src/pulse_engine.h), stepped like the valves task
+// Run with: pio test -e native -f test_pulse
+#include <unity.h>
+#include "pulse_engine.h"
+
+// Stubbed clock and valve layer: a valve closes once its duration has elapsed, checked at
+// the start of every simulated loop pass like taskValves() does
+uint64_t simNowMs;
+bool simOpen[PULSE_CHANNELS];
+uint64_t simOpenedMs[PULSE_CHANNELS];
+uint32_t simDurationMs[PULSE_CHANNELS];
+uint64_t simDeliveredMs[PULSE_CHANNELS];
+uint32_t simOpens[PULSE_CHANNELS];
+uint32_t simFirstPulses[PULSE_CHANNELS]; // Opens of cycle 0, which the firmware counts as activations
+uint8_t simSources[PULSE_CHANNELS];
+uint8_t simMaxOpen;
+uint32_t simNotices[4];
+uint32_t simSeed;
+const uint8_t SIM_SOURCE = 2;
+
+uint64_t pulseNowMs() { return simNowMs; }
+bool pulseValveIsOpen(uint8_t channel) { return simOpen[channel]; }
+void pulseValveClose(uint8_t channel) {
+  simOpen[channel] = false;
+  simDeliveredMs[channel] += simNowMs - simOpenedMs[channel];
+}
+void pulseValveOpen(uint8_t channel, uint32_t durationMs) {
+  simOpen[channel] = true;
+  simOpenedMs[channel] = simNowMs;
+  simDurationMs[channel] = durationMs;
+  simOpens[channel]++;
+  simFirstPulses[channel] += pulsePrograms[channel].cycle == 0;
+  simSources[channel] = pulsePrograms[channel].source;
+  uint8_t open = 0;
+  for (uint8_t i = 0; i < PULSE_CHANNELS; ++i) {
+    open += simOpen[i];
+  }
+  simMaxOpen = open > simMaxOpen ? open : simMaxOpen;
+}
+void pulsePhaseChanged(uint8_t channel) {}
+void pulseNotify(uint8_t channel, PulseNotice notice) { simNotices[notice]++; }
+
+// One loop pass of loopMs plus up to jitterMs of slow handlers
+void simPass(uint32_t loopMs, uint32_t jitterMs) {
+  simSeed = simSeed * 1664525 + 1013904223;
+  simNowMs += loopMs + (jitterMs ? (simSeed >> 8) % (jitterMs + 1) : 0);
+  for (uint8_t i = 0; i < PULSE_CHANNELS; ++i) {
+    if (simOpen[i] && simNowMs - simOpenedMs[i] >= simDurationMs[i]) {
+      pulseValveClose(i);
+    }
+  }
+  pulseUpdate();
+}
+
+bool anyRunning() {
+  for (uint8_t i = 0; i < PULSE_CHANNELS; ++i) {
+    if (pulsePrograms[i].phase != PULSE_IDLE) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void setUp() {
+  simNowMs = 1000;
+  simMaxOpen = 0;
+  simSeed = 7;
+  for (uint8_t i = 0; i < PULSE_CHANNELS; ++i) {
+    simOpen[i] = false;
+    simDeliveredMs[i] = 0;
+    simOpens[i] = 0;
+    simFirstPulses[i] = 0;
+    simSources[i] = 0;
+    pulsePrograms[i] = {};
+    pulseSettings[i] = {1, 20, 0};
+  }
+  for (uint32_t& n : simNotices) {
+    n = 0;
+  }
+  pulseSupplyValves = PULSE_CHANNELS;
+}
+void tearDown() {}
+
+void test_split_is_exact_and_ramped() {
+  uint32_t pulses[PULSE_MAX_CYCLES];
+  PulseSettings ramp = {4, 10, 20};
+  TEST_ASSERT_EQUAL_UINT8(4, pulseSplit(ramp, 3600000, pulses));
+  // Weights 100, 120, 140, 160 of 520
+  TEST_ASSERT_EQUAL_UINT32(692307, pulses[0]);
+  TEST_ASSERT_EQUAL_UINT32(830769, pulses[1]);
+  TEST_ASSERT_EQUAL_UINT32(969230, pulses[2]);
+  TEST_ASSERT_EQUAL_UINT32(3600000, pulses[0] + pulses[1] + pulses[2] + pulses[3]);
+
+  PulseSettings steep = {10, 10, -50}; // Weights bottom out at 10
+  TEST_ASSERT_EQUAL_UINT8(10, pulseSplit(steep, 3600000, pulses));
+  TEST_ASSERT_UINT32_WITHIN(10, pulses[3], pulses[9]); // The last pulse takes the rounding
+
+  PulseSettings many = {10, 10, 0}; // 2 min total: at most 4 pulses of 30 s
+  TEST_ASSERT_EQUAL_UINT8(4, pulseSplit(many, 120000, pulses));
+  PulseSettings zero = {0, 10, 0};
+  TEST_ASSERT_EQUAL_UINT8(1, pulseSplit(zero, 120000, pulses));
+}
+
+// A 10-pulse program with 30 min soaks and slow loop passes: every pulse ends within two
+// passes of its nominal end (one late start, one late timeout) and the program finishes
+// within two passes of the ideal time, because boundaries are derived from nominal ones
+// instead of from when the loop got there
+void test_long_program_does_not_accumulate_latency() {
+  const uint32_t loopMs = 15;
+  const uint32_t jitterMs = 40;
+  pulseSettings[0] = {10, 30, 0};
+  uint64_t startMs = simNowMs;
+  pulseStart(0, 60 * 60000UL, SIM_SOURCE);
+  TEST_ASSERT_EQUAL(PULSE_ON, pulsePrograms[0].phase);
+
+  uint32_t worstEndErrorMs = 0;
+  uint64_t deadlineMs = pulsePrograms[0].deadlineMs;
+  while (anyRunning()) {
+    bool wasOpen = simOpen[0];
+    simPass(loopMs, jitterMs);
+    if (wasOpen && !simOpen[0]) {
+      uint32_t errorMs = simNowMs - deadlineMs;
+      worstEndErrorMs = errorMs > worstEndErrorMs ? errorMs : worstEndErrorMs;
+    }
+    if (simOpen[0]) {
+      deadlineMs = pulsePrograms[0].deadlineMs;
+    }
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(2 * (loopMs + jitterMs), worstEndErrorMs);
+  TEST_ASSERT_EQUAL_UINT32(10, simOpens[0]);
+  TEST_ASSERT_EQUAL_UINT32(1, simFirstPulses[0]); // One activation per program
+  TEST_ASSERT_EQUAL_UINT8(SIM_SOURCE, simSources[0]);
+  // Delivered water is exact up to one pass per pulse
+  TEST_ASSERT_UINT32_WITHIN(10 * (loopMs + jitterMs), 60 * 60000UL, simDeliveredMs[0]);
+  uint64_t idealMs = 60 * 60000ULL + 9 * 30 * 60000ULL;
+  TEST_ASSERT_GREATER_OR_EQUAL(idealMs, simNowMs - startMs);
+  TEST_ASSERT_LESS_OR_EQUAL(idealMs + 2 * (loopMs + jitterMs), simNowMs - startMs);
+  TEST_ASSERT_EQUAL(1, simNotices[PULSE_NOTICE_DONE]);
+}
+
+// Three zones on a supply that feeds one valve: never two open, each zone gets its full ON
+// time, and interleaving beats running the programs back to back
+void test_supply_sharing_interleaves_zones() {
+  pulseSupplyValves = 1;
+  pulseSettings[0] = {4, 20, 0};
+  pulseSettings[1] = {3, 15, -10};
+  pulseSettings[2] = {3, 30, 0};
+  const uint32_t totals[PULSE_CHANNELS] = {30 * 60000UL, 20 * 60000UL, 15 * 60000UL};
+  uint64_t startMs = simNowMs;
+  for (uint8_t i = 0; i < PULSE_CHANNELS; ++i) {
+    pulseStart(i, totals[i], SIM_SOURCE);
+  }
+  TEST_ASSERT_TRUE(simOpen[0]);
+  TEST_ASSERT_EQUAL(PULSE_WAITING, pulsePrograms[1].phase);
+  TEST_ASSERT_EQUAL(PULSE_WAITING, pulsePrograms[2].phase);
+
+  while (anyRunning()) {
+    simPass(10, 5);
+  }
+  uint64_t makespanMs = simNowMs - startMs;
+  uint64_t backToBackMs = 0;
+  for (uint8_t i = 0; i < PULSE_CHANNELS; ++i) {
+    TEST_ASSERT_UINT32_WITHIN(pulseSettings[i].cycles * 15, totals[i], simDeliveredMs[i]);
+    TEST_ASSERT_EQUAL_UINT32(pulseSettings[i].cycles, simOpens[i]);
+    backToBackMs += totals[i] + (uint64_t)(pulseSettings[i].cycles - 1) * pulseSettings[i].soakMinutes * 60000UL;
+  }
+  TEST_ASSERT_EQUAL_UINT8(1, simMaxOpen);
+  TEST_ASSERT_LESS_THAN(backToBackMs - 60 * 60000ULL, makespanMs); // Saves over an hour here
+  TEST_ASSERT_GREATER_THAN(0, pulsePrograms[1].waitedMs);
+}
+
+// The earliest-released waiting zone gets the supply first
+void test_supply_goes_to_earliest_release() {
+  pulseSupplyValves = 1;
+  pulseStart(0, 10 * 60000UL, SIM_SOURCE);
+  simPass(1000, 0);
+  pulseStart(2, 10 * 60000UL, SIM_SOURCE);
+  simPass(1000, 0);
+  pulseStart(1, 10 * 60000UL, SIM_SOURCE);
+  while (simOpen[0]) {
+    simPass(1000, 0);
+  }
+  TEST_ASSERT_TRUE(simOpen[2]);
+  TEST_ASSERT_FALSE(simOpen[1]);
+}
+
+void test_manual_close_and_cancel_stop_the_program() {
+  pulseSettings[0] = {3, 10, 0};
+  pulseStart(0, 30 * 60000UL, SIM_SOURCE);
+  pulseStart(0, 30 * 60000UL, SIM_SOURCE);
+  TEST_ASSERT_EQUAL(1, simNotices[PULSE_NOTICE_BUSY]);
+  simPass(60000, 0);
+  pulseValveClose(0); // Switched off from the web page mid-pulse
+  simPass(10, 0);
+  TEST_ASSERT_EQUAL(PULSE_IDLE, pulsePrograms[0].phase);
+  TEST_ASSERT_EQUAL(1, simNotices[PULSE_NOTICE_STOPPED]);
+
+  pulseStart(0, 30 * 60000UL, SIM_SOURCE);
+  while (pulsePrograms[0].phase != PULSE_SOAK) {
+    simPass(1000, 0);
+  }
+  pulseCancel(0);
+  TEST_ASSERT_EQUAL(PULSE_IDLE, pulsePrograms[0].phase);
+  for (int i = 0; i < 100; ++i) {
+    simPass(60000, 0);
+  }
+  TEST_ASSERT_EQUAL_UINT32(2, simOpens[0]); // Nothing reopened after the cancel
+}
+
+// The console "on" command refuses a channel whose program is in any phase, so a manual run
+// never shares a valve with the engine
+void test_channel_busy_for_the_whole_program() {
+  pulseSupplyValves = 1;
+  pulseSettings[0] = {3, 10, 0};
+  pulseStart(0, 30 * 60000UL, SIM_SOURCE);
+  pulseStart(1, 10 * 60000UL, SIM_SOURCE);
+  TEST_ASSERT_EQUAL(PULSE_WAITING, pulsePrograms[1].phase);
+  TEST_ASSERT_TRUE(pulseChannelBusy(1));
+  TEST_ASSERT_FALSE(pulseChannelBusy(2));
+
+  bool sawOn = false, sawSoak = false;
+  while (pulsePrograms[0].phase != PULSE_IDLE) {
+    TEST_ASSERT_TRUE(pulseChannelBusy(0));
+    sawOn |= pulsePrograms[0].phase == PULSE_ON;
+    sawSoak |= pulsePrograms[0].phase == PULSE_SOAK;
+    simPass(1000, 0);
+  }
+  TEST_ASSERT_TRUE(sawOn && sawSoak);
+  TEST_ASSERT_FALSE(pulseChannelBusy(0));
+
+  simOpen[2] = true; // Opened by hand, no program
+  TEST_ASSERT_TRUE(pulseChannelBusy(2));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_split_is_exact_and_ramped);
+  RUN_TEST(test_long_program_does_not_accumulate_latency);
+  RUN_TEST(test_supply_sharing_interleaves_zones);
+  RUN_TEST(test_supply_goes_to_earliest_release);
+  RUN_TEST(test_manual_close_and_cancel_stop_the_program);
+  RUN_TEST(test_channel_busy_for_the_whole_program);
+  return UNITY_END();
+}
@@ -0,0 +1,116 @@
+// Host tests for the settings JSON mapping (src/settings_json.h), fed the payloads the web UI
+// and the console send. Host pointers are wider than on the ESP8266, so a document that fits
+// here also fits on the device.
+// Run with: pio test -e native -f test_settings
+#include <unity.h>
+#include "settings_json.h"
+
+SolenoidSettings solenoid1Settings;
+SolenoidSettings solenoid2Settings;
+SolenoidSettings solenoid3Settings;
+SolenoidSettings* const solenoidSettings[PULSE_CHANNELS] = {&solenoid1Settings, &solenoid2Settings, &solenoid3Settings};
+SoftClock softClock;
+SoilSettings soilSettings;
+
+// Stubbed EEPROM: loadSettings() restores the defaults setUp() saved
+const SolenoidSettings SAVED_SOLENOID = {1, 12, 0, false};
+const SoilSettings SAVED_SOIL = {false, 800, 400, 60, 50, 30};
+uint32_t loads;
+void loadSettings() {
+  solenoid1Settings = solenoid2Settings = solenoid3Settings = SAVED_SOLENOID;
+  softClock = {0, 0, 0, 0, 0, 2 * 60};
+  soilSettings = SAVED_SOIL;
+  for (PulseSettings& settings : pulseSettings) {
+    settings = {1, 20, 0};
+  }
+  loads++;
+}
+
+// JSON.stringify() of the settings form: the 12 schedule fields, then addPulseSettings()
+const char* const UI_PAYLOAD =
+    "{\"solenoid1OnTime\":15,\"solenoid1SchedHour\":6,\"solenoid1SchedMin\":30,\"solenoid1SchedEnabled\":true,"
+    "\"solenoid2OnTime\":20,\"solenoid2SchedHour\":7,\"solenoid2SchedMin\":0,\"solenoid2SchedEnabled\":false,"
+    "\"solenoid3OnTime\":1440,\"solenoid3SchedHour\":23,\"solenoid3SchedMin\":59,\"solenoid3SchedEnabled\":true,"
+    "\"solenoid1PulseCycles\":4,\"solenoid1SoakMin\":20,\"solenoid1RampPercent\":-10,"
+    "\"solenoid2PulseCycles\":1,\"solenoid2SoakMin\":0,\"solenoid2RampPercent\":0,"
+    "\"solenoid3PulseCycles\":10,\"solenoid3SoakMin\":240,\"solenoid3RampPercent\":50}";
+
+// Every key applySettingsJson() reads, as GET /settings writes them
+const char* const FULL_PAYLOAD =
+    "{\"solenoid1OnTime\":1440,\"solenoid1SchedHour\":23,\"solenoid1SchedMin\":59,\"solenoid1SchedEnabled\":true,"
+    "\"solenoid2OnTime\":1440,\"solenoid2SchedHour\":23,\"solenoid2SchedMin\":59,\"solenoid2SchedEnabled\":true,"
+    "\"solenoid3OnTime\":1440,\"solenoid3SchedHour\":23,\"solenoid3SchedMin\":59,\"solenoid3SchedEnabled\":true,"
+    "\"tzOffsetMinutes\":-600,"
+    "\"soilEnabled\":true,\"soilRawDry\":1023,\"soilRawWet\":300,\"soilWetOnPercent\":70,\"soilWetOffPercent\":60,"
+    "\"soilDryPercent\":30,"
+    "\"solenoid1PulseCycles\":10,\"solenoid1SoakMin\":240,\"solenoid1RampPercent\":-50,"
+    "\"solenoid2PulseCycles\":10,\"solenoid2SoakMin\":240,\"solenoid2RampPercent\":-50,"
+    "\"solenoid3PulseCycles\":10,\"solenoid3SoakMin\":240,\"solenoid3RampPercent\":-50}";
+
+void setUp() {
+  loadSettings();
+  loads = 0;
+}
+void tearDown() {}
+
+void test_ui_payload_fits_and_applies() {
+  DynamicJsonDocument doc(SETTINGS_JSON_CAPACITY);
+  TEST_ASSERT_FALSE(deserializeJson(doc, UI_PAYLOAD));
+  bool settingsChanged = false;
+  TEST_ASSERT_NULL(applySettingsJson(doc, settingsChanged));
+  TEST_ASSERT_TRUE(settingsChanged);
+  TEST_ASSERT_EQUAL_UINT32(15, solenoid1Settings.onTime);
+  TEST_ASSERT_EQUAL_UINT8(30, solenoid1Settings.scheduleMinute);
+  TEST_ASSERT_TRUE(solenoid1Settings.scheduleEnabled);
+  TEST_ASSERT_FALSE(solenoid2Settings.scheduleEnabled);
+  TEST_ASSERT_EQUAL_UINT32(1440, solenoid3Settings.onTime);
+  TEST_ASSERT_EQUAL_UINT8(4, pulseSettings[0].cycles);
+  TEST_ASSERT_EQUAL_INT8(-10, pulseSettings[0].rampPercent);
+  TEST_ASSERT_EQUAL_UINT8(240, pulseSettings[2].soakMinutes);
+  TEST_ASSERT_EQUAL_UINT32(0, loads);
+}
+
+void test_full_key_set_fits() {
+  DynamicJsonDocument doc(SETTINGS_JSON_CAPACITY);
+  TEST_ASSERT_FALSE(deserializeJson(doc, FULL_PAYLOAD));
+  bool settingsChanged = false;
+  TEST_ASSERT_NULL(applySettingsJson(doc, settingsChanged));
+  TEST_ASSERT_EQUAL_INT16(-600, softClock.tzOffsetMinutes);
+  TEST_ASSERT_EQUAL_UINT16(1023, soilSettings.rawDry);
+  TEST_ASSERT_EQUAL_UINT8(10, pulseSettings[1].cycles);
+}
+
+// The 512-byte document POST /settings used before cannot hold the UI payload
+void test_old_capacity_was_too_small() {
+  DynamicJsonDocument doc(512);
+  TEST_ASSERT_TRUE(deserializeJson(doc, UI_PAYLOAD) == DeserializationError::NoMemory);
+}
+
+// A rejected update restores the saved settings instead of keeping the valid fields
+void test_rejected_update_restores_saved_settings() {
+  DynamicJsonDocument doc(SETTINGS_JSON_CAPACITY);
+  const char* const rejected[] = {
+      "{\"solenoid1OnTime\":30,\"solenoid1SoakMin\":300}",
+      "{\"solenoid1OnTime\":30,\"solenoid2OnTime\":0}",
+      "{\"solenoid1OnTime\":30,\"solenoid3RampPercent\":-200}",
+      "{\"solenoid1OnTime\":30,\"solenoid2PulseCycles\":11}",
+      "{\"solenoid1OnTime\":30,\"soilWetOffPercent\":90}",
+  };
+  for (const char* payload : rejected) {
+    TEST_ASSERT_FALSE(deserializeJson(doc, payload));
+    bool settingsChanged = false;
+    TEST_ASSERT_NOT_NULL_MESSAGE(applySettingsJson(doc, settingsChanged), payload);
+    TEST_ASSERT_FALSE(settingsChanged);
+    TEST_ASSERT_EQUAL_UINT32(1, solenoid1Settings.onTime);
+  }
+  TEST_ASSERT_EQUAL_UINT32(5, loads);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ui_payload_fits_and_applies);
+  RUN_TEST(test_full_key_set_fits);
+  RUN_TEST(test_old_capacity_was_too_small);
+  RUN_TEST(test_rejected_update_restores_saved_settings);
+  return UNITY_END();
+}
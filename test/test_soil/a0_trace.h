@@ -0,0 +1,154 @@
+// A0 trace for test_soil, synthesised from a capacitive sensor model. 10-bit reads as
+// soilSample() sees them, 16 per decimated sample (140 samples, 44.8 s at SOIL_ADC_INTERVAL).
+// The sensor reads lower when wet and is calibrated rawDry = 800, rawWet = 400. Dry soil, a
+// watering front, a hover around wetOnPercent 60 % (raw 560), saturation, then drying
+// through a hover around wetOffPercent 50 % (raw 600). Individual reads are hit by 0/1023 spikes,
+// and whole samples at A0_TRACE_GLITCHES are lost to contact glitches (up to two in a row).
+#pragma once
+
+#include <stdint.h>
+
+const uint16_t A0_TRACE_GLITCHES[] = {12, 20, 21, 48, 75, 96, 97, 120};
+
+const uint16_t A0_TRACE[] = {
+  778, 779, 780, 783, 784, 784, 778, 784, 781, 784, 783, 783, 780, 777, 780, 782,
+  780, 784, 783, 776, 782, 780, 781, 784, 779, 777, 776, 781, 780, 779, 777, 781,
+  777, 781, 779, 784, 780, 781, 776, 781, 784, 780, 784, 782, 782, 778, 777, 776,
+  781, 784, 777, 777, 778, 777, 777, 781, 776, 776, 782, 780, 781, 779, 1023, 1023,
+  780, 783, 777, 776, 783, 782, 782, 781, 777, 779, 776, 784, 783, 781, 778, 783,
+  783, 776, 777, 780, 783, 780, 782, 784, 782, 780, 783, 783, 782, 776, 782, 781,
+  781, 778, 777, 778, 781, 780, 778, 781, 782, 782, 781, 781, 784, 776, 776, 779,
+  1023, 777, 780, 777, 0, 779, 779, 779, 777, 777, 776, 782, 784, 781, 776, 778,
+  783, 776, 776, 779, 784, 779, 777, 781, 781, 777, 783, 780, 776, 776, 776, 783,
+  780, 781, 781, 784, 778, 781, 777, 781, 782, 783, 783, 780, 779, 777, 784, 779,
+  778, 780, 777, 778, 782, 784, 778, 778, 783, 784, 783, 783, 781, 779, 776, 776,
+  776, 777, 778, 781, 778, 781, 780, 779, 780, 776, 783, 783, 782, 780, 780, 779,
+  330, 330, 330, 330, 330, 330, 330, 330, 330, 330, 330, 330, 330, 330, 330, 330,
+  776, 780, 778, 782, 776, 781, 777, 777, 779, 782, 781, 779, 782, 776, 779, 778,
+  784, 778, 782, 777, 783, 779, 779, 782, 780, 780, 782, 780, 782, 779, 782, 783,
+  783, 782, 777, 0, 1023, 778, 780, 779, 776, 777, 778, 778, 782, 781, 783, 778,
+  778, 784, 782, 778, 784, 777, 782, 777, 784, 783, 782, 776, 777, 783, 783, 779,
+  784, 780, 778, 784, 784, 782, 780, 783, 779, 782, 780, 776, 780, 778, 783, 780,
+  776, 780, 780, 779, 780, 783, 776, 779, 780, 782, 784, 781, 781, 777, 779, 776,
+  782, 781, 779, 784, 780, 781, 780, 781, 776, 780, 777, 778, 784, 779, 776, 780,
+  300, 300, 300, 300, 300, 300, 300, 300, 300, 300, 300, 300, 300, 300, 300, 300,
+  310, 310, 310, 310, 310, 310, 310, 310, 310, 310, 310, 310, 310, 310, 310, 310,
+  776, 782, 784, 781, 781, 777, 782, 784, 781, 780, 781, 779, 776, 776, 784, 784,
+  783, 777, 780, 783, 780, 777, 781, 782, 781, 778, 782, 778, 780, 778, 778, 783,
+  781, 781, 780, 780, 780, 781, 776, 780, 778, 777, 782, 784, 781, 778, 778, 783,
+  778, 782, 779, 778, 780, 778, 782, 784, 779, 783, 1023, 1023, 779, 778, 781, 784,
+  778, 780, 778, 777, 777, 784, 777, 776, 778, 778, 784, 782, 784, 777, 783, 779,
+  776, 784, 782, 782, 776, 784, 781, 776, 783, 777, 779, 778, 778, 783, 780, 781,
+  781, 779, 784, 778, 779, 778, 779, 777, 781, 784, 779, 778, 776, 777, 779, 779,
+  784, 782, 783, 783, 777, 781, 780, 782, 781, 784, 784, 776, 777, 779, 781, 778,
+  762, 761, 761, 759, 759, 763, 764, 760, 766, 758, 766, 759, 758, 764, 766, 764,
+  745, 744, 745, 746, 745, 743, 748, 741, 748, 745, 746, 742, 741, 740, 744, 748,
+  726, 722, 730, 724, 730, 728, 730, 728, 726, 730, 724, 726, 728, 730, 728, 728,
+  707, 710, 705, 707, 713, 710, 710, 711, 710, 709, 706, 709, 709, 710, 710, 708,
+  689, 691, 687, 693, 695, 690, 690, 695, 695, 688, 690, 695, 689, 695, 695, 695,
+  673, 673, 672, 671, 669, 675, 674, 675, 671, 675, 674, 669, 669, 676, 671, 674,
+  652, 656, 654, 653, 658, 656, 651, 651, 658, 656, 655, 653, 655, 659, 656, 653,
+  640, 639, 635, 633, 640, 633, 637, 635, 638, 634, 640, 634, 633, 636, 634, 635,
+  616, 616, 622, 616, 620, 618, 620, 616, 622, 618, 622, 616, 616, 618, 618, 624,
+  604, 600, 599, 602, 606, 605, 600, 605, 605, 604, 603, 606, 605, 604, 599, 605,
+  582, 583, 586, 585, 584, 588, 586, 583, 588, 582, 585, 588, 585, 580, 586, 585,
+  562, 562, 563, 567, 563, 566, 564, 568, 568, 569, 566, 567, 565, 562, 567, 563,
+  567, 563, 565, 568, 567, 568, 563, 568, 563, 567, 567, 563, 566, 568, 564, 562,
+  563, 558, 562, 560, 560, 564, 564, 566, 558, 560, 565, 560, 558, 564, 560, 563,
+  559, 561, 558, 560, 557, 555, 561, 555, 1023, 562, 560, 558, 557, 563, 558, 561,
+  564, 565, 560, 565, 562, 559, 562, 562, 563, 560, 566, 560, 563, 560, 561, 566,
+  558, 565, 560, 560, 562, 558, 560, 557, 561, 562, 561, 558, 563, 565, 563, 558,
+  555, 556, 554, 562, 556, 554, 561, 558, 555, 555, 561, 560, 555, 554, 560, 557,
+  1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023,
+  562, 556, 558, 563, 562, 563, 561, 563, 557, 559, 560, 560, 556, 558, 556, 564,
+  557, 556, 556, 556, 554, 553, 560, 553, 555, 559, 556, 556, 553, 560, 555, 559,
+  560, 565, 562, 558, 558, 564, 560, 564, 561, 560, 562, 563, 559, 562, 563, 563,
+  559, 562, 555, 557, 0, 558, 1023, 556, 560, 561, 561, 555, 558, 556, 557, 558,
+  560, 556, 556, 560, 554, 553, 558, 559, 553, 553, 558, 555, 558, 557, 557, 559,
+  562, 564, 563, 565, 558, 565, 563, 561, 559, 563, 564, 561, 564, 558, 560, 565,
+  559, 556, 551, 555, 559, 558, 552, 555, 559, 558, 551, 556, 554, 553, 558, 557,
+  558, 561, 556, 556, 556, 558, 562, 558, 560, 561, 559, 558, 555, 555, 560, 561,
+  547, 545, 550, 548, 545, 553, 550, 553, 550, 547, 549, 549, 545, 545, 547, 545,
+  548, 545, 540, 545, 546, 548, 547, 548, 542, 543, 547, 548, 545, 548, 546, 543,
+  538, 538, 537, 542, 538, 537, 541, 536, 539, 534, 537, 539, 540, 539, 535, 538,
+  529, 530, 531, 529, 530, 530, 535, 533, 535, 533, 532, 533, 535, 533, 531, 531,
+  523, 524, 530, 527, 523, 531, 530, 531, 528, 531, 523, 527, 529, 523, 531, 528,
+  524, 517, 525, 518, 520, 518, 521, 517, 519, 524, 520, 525, 525, 525, 522, 522,
+  515, 514, 516, 513, 519, 513, 515, 516, 515, 514, 512, 517, 515, 519, 515, 516,
+  512, 507, 510, 509, 514, 508, 511, 510, 509, 514, 509, 511, 511, 511, 514, 512,
+  506, 506, 501, 503, 504, 502, 500, 504, 502, 508, 500, 502, 504, 500, 503, 501,
+  501, 494, 502, 0, 1023, 494, 497, 496, 499, 495, 496, 501, 495, 498, 496, 494,
+  494, 494, 490, 490, 495, 492, 489, 493, 493, 493, 490, 491, 492, 496, 497, 490,
+  484, 483, 486, 486, 486, 491, 486, 488, 486, 489, 489, 491, 487, 487, 491, 483,
+  481, 479, 484, 478, 481, 484, 485, 477, 477, 480, 477, 480, 482, 477, 480, 477,
+  479, 477, 479, 473, 479, 472, 480, 474, 478, 479, 472, 472, 477, 473, 472, 473,
+  473, 474, 471, 470, 473, 473, 468, 471, 471, 474, 471, 467, 468, 468, 469, 473,
+  466, 469, 466, 467, 471, 472, 466, 467, 467, 473, 471, 474, 473, 468, 466, 474,
+  468, 467, 469, 469, 470, 467, 474, 469, 467, 467, 470, 467, 470, 467, 469, 469,
+  472, 468, 474, 468, 470, 470, 472, 472, 472, 471, 472, 467, 470, 473, 471, 472,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  472, 472, 473, 469, 471, 474, 466, 470, 469, 472, 472, 470, 473, 466, 471, 473,
+  467, 471, 468, 472, 473, 466, 469, 467, 473, 470, 468, 466, 472, 466, 466, 473,
+  470, 474, 474, 473, 472, 468, 473, 474, 473, 470, 472, 471, 466, 474, 471, 468,
+  471, 471, 472, 466, 471, 468, 469, 466, 468, 472, 472, 470, 472, 470, 472, 469,
+  470, 477, 474, 0, 475, 475, 472, 477, 477, 473, 475, 475, 474, 478, 0, 477,
+  482, 482, 481, 479, 481, 479, 480, 479, 481, 481, 478, 476, 479, 477, 480, 477,
+  479, 486, 485, 484, 479, 486, 482, 481, 480, 479, 484, 485, 482, 479, 481, 483,
+  489, 490, 483, 491, 485, 490, 488, 490, 489, 485, 485, 486, 484, 484, 490, 490,
+  492, 494, 490, 493, 489, 495, 493, 492, 493, 494, 494, 493, 493, 494, 494, 489,
+  496, 500, 498, 498, 495, 497, 497, 493, 495, 493, 495, 499, 497, 494, 492, 497,
+  498, 496, 503, 499, 501, 496, 499, 496, 498, 501, 502, 498, 497, 497, 501, 502,
+  504, 507, 508, 508, 501, 503, 506, 502, 503, 508, 500, 504, 506, 504, 508, 505,
+  512, 505, 509, 505, 510, 510, 505, 511, 504, 506, 507, 512, 506, 505, 509, 509,
+  516, 517, 515, 515, 509, 517, 515, 514, 510, 509, 510, 514, 511, 510, 510, 515,
+  520, 517, 518, 521, 515, 513, 521, 520, 521, 517, 520, 517, 520, 519, 521, 514,
+  519, 523, 523, 517, 520, 517, 522, 525, 520, 517, 520, 518, 519, 519, 521, 518,
+  524, 528, 526, 527, 525, 522, 526, 525, 528, 529, 526, 521, 525, 522, 522, 522,
+  533, 526, 527, 530, 526, 528, 534, 530, 526, 531, 534, 526, 527, 527, 534, 532,
+  531, 533, 531, 535, 531, 531, 533, 538, 535, 538, 533, 536, 534, 537, 531, 530,
+  539, 534, 537, 537, 540, 535, 539, 534, 539, 535, 541, 534, 542, 538, 541, 534,
+  1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023,
+  1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023, 1023,
+  548, 555, 549, 555, 549, 551, 547, 554, 548, 549, 550, 550, 549, 554, 548, 549,
+  552, 552, 557, 554, 559, 551, 554, 552, 556, 553, 556, 554, 559, 556, 559, 559,
+  563, 561, 560, 558, 561, 556, 563, 561, 563, 562, 563, 559, 562, 556, 564, 558,
+  560, 564, 565, 563, 563, 566, 567, 568, 563, 560, 567, 568, 562, 560, 561, 565,
+  571, 567, 566, 566, 572, 566, 566, 564, 572, 566, 568, 570, 569, 566, 568, 569,
+  568, 576, 571, 573, 1023, 573, 568, 573, 1023, 570, 575, 570, 571, 568, 573, 569,
+  574, 575, 578, 578, 577, 579, 576, 576, 574, 579, 580, 581, 576, 575, 579, 578,
+  585, 578, 577, 580, 583, 583, 584, 578, 580, 582, 582, 578, 581, 582, 580, 581,
+  584, 581, 585, 586, 588, 581, 586, 589, 587, 582, 589, 588, 584, 582, 584, 581,
+  591, 589, 588, 591, 589, 593, 593, 593, 591, 586, 589, 590, 593, 590, 587, 591,
+  597, 595, 592, 596, 595, 596, 597, 595, 596, 592, 595, 595, 592, 595, 593, 598,
+  598, 600, 601, 601, 596, 599, 598, 601, 600, 597, 595, 599, 602, 602, 597, 598,
+  600, 594, 595, 600, 601, 594, 599, 595, 601, 1023, 596, 597, 0, 594, 600, 596,
+  605, 598, 604, 602, 597, 603, 600, 605, 600, 598, 604, 604, 603, 600, 599, 597,
+  599, 600, 598, 602, 598, 598, 602, 596, 595, 598, 600, 598, 603, 596, 598, 595,
+  602, 604, 606, 599, 604, 606, 606, 603, 602, 604, 603, 600, 604, 601, 601, 599,
+  596, 596, 596, 595, 599, 602, 600, 594, 595, 597, 598, 598, 601, 595, 601, 598,
+  600, 605, 599, 603, 606, 606, 599, 605, 599, 598, 606, 601, 602, 602, 606, 604,
+  603, 599, 596, 599, 596, 599, 601, 598, 604, 602, 598, 597, 597, 604, 602, 602,
+  605, 605, 604, 601, 605, 601, 605, 606, 601, 604, 604, 608, 607, 606, 600, 601,
+  599, 605, 602, 597, 601, 598, 603, 598, 600, 597, 602, 601, 602, 604, 603, 603,
+  603, 609, 609, 605, 602, 607, 603, 603, 609, 606, 610, 604, 607, 606, 603, 610,
+  250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250, 250,
+  608, 607, 610, 612, 611, 606, 605, 611, 609, 612, 609, 608, 607, 609, 610, 609,
+  605, 609, 607, 605, 602, 609, 607, 608, 606, 603, 607, 607, 604, 607, 609, 606,
+  612, 612, 608, 607, 607, 615, 614, 612, 615, 607, 614, 612, 607, 608, 613, 610,
+  615, 617, 621, 617, 617, 614, 617, 616, 616, 620, 615, 620, 618, 618, 613, 618,
+  624, 1023, 624, 626, 0, 619, 618, 625, 622, 619, 618, 625, 626, 621, 621, 618,
+  627, 629, 629, 624, 631, 627, 629, 625, 631, 628, 629, 628, 626, 625, 631, 627,
+  631, 632, 637, 629, 633, 637, 633, 631, 634, 629, 632, 636, 632, 632, 635, 633,
+  642, 643, 639, 640, 635, 636, 641, 636, 638, 642, 639, 635, 636, 642, 643, 641,
+  647, 640, 640, 646, 645, 643, 643, 643, 644, 647, 646, 644, 645, 640, 645, 642,
+  650, 652, 651, 653, 653, 648, 652, 648, 652, 647, 650, 653, 649, 654, 654, 653,
+  658, 658, 656, 652, 654, 652, 658, 658, 656, 654, 652, 658, 656, 656, 660, 652,
+  664, 657, 661, 660, 661, 664, 661, 660, 664, 661, 662, 661, 661, 661, 660, 662,
+  668, 664, 665, 665, 665, 664, 667, 667, 665, 670, 664, 670, 668, 665, 665, 665,
+  676, 674, 672, 672, 672, 675, 670, 673, 668, 672, 668, 674, 674, 676, 674, 672,
+  675, 676, 674, 681, 679, 675, 681, 681, 679, 675, 681, 680, 677, 680, 678, 681,
+  683, 686, 680, 680, 685, 682, 687, 686, 686, 682, 685, 687, 686, 681, 687, 684,
+  686, 692, 692, 689, 691, 692, 692, 689, 685, 691, 691, 692, 685, 689, 692, 693,
+  694, 698, 695, 693, 691, 696, 693, 698, 691, 692, 695, 694, 691, 693, 693, 694,
+  704, 699, 703, 699, 698, 696, 700, 698, 701, 699, 703, 697, 700, 699, 700, 704,
+};
@@ -0,0 +1,186 @@
+// Host tests for the soil moisture filter chain (src/soil_filter.h)
+// Run with: pio test -e native -f test_soil
+#include <unity.h>
+#include "soil_filter.h"
+#include "a0_trace.h"
+
+const SoilSettings CAPACITIVE = {true, 800, 400, 60, 50, 30}; // Reads lower when wet
+const SoilSettings RESISTIVE = {true, 223, 623, 60, 50, 30};  // Mirror image: reads higher when wet
+
+const uint16_t TRACE_READS = sizeof(A0_TRACE) / sizeof(A0_TRACE[0]);
+const uint16_t TRACE_SAMPLES = TRACE_READS / SOIL_OVERSAMPLE;
+
+// Filter output after every decimated sample of the trace
+struct TraceRun {
+  uint16_t decimated[TRACE_SAMPLES];
+  uint16_t filtered[TRACE_SAMPLES];
+  uint8_t percent[TRACE_SAMPLES];
+  bool wet[TRACE_SAMPLES];
+};
+
+void replay(TraceRun& run, const SoilSettings& settings, bool mirror) {
+  SoilFilter f = {};
+  uint16_t sample = 0;
+  for (uint16_t i = 0; i < TRACE_READS; ++i) {
+    uint16_t raw = mirror ? 1023 - A0_TRACE[i] : A0_TRACE[i];
+    uint16_t decimated;
+    if (soilDecimate(f, raw, decimated)) {
+      soilFilterUpdate(f, settings, decimated);
+      run.decimated[sample] = decimated;
+      run.filtered[sample] = f.filtered;
+      run.percent[sample] = f.percent;
+      run.wet[sample] = f.wet;
+      sample++;
+    }
+  }
+  TEST_ASSERT_EQUAL(TRACE_SAMPLES, sample);
+}
+
+bool isGlitch(uint16_t sample) {
+  for (uint16_t glitch : A0_TRACE_GLITCHES) {
+    if (glitch == sample) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_decimation_sums_to_12_bit() {
+  SoilFilter f = {};
+  uint16_t decimated = 0;
+  for (uint8_t i = 0; i < SOIL_OVERSAMPLE - 1; ++i) {
+    TEST_ASSERT_FALSE(soilDecimate(f, 1023, decimated));
+  }
+  TEST_ASSERT_TRUE(soilDecimate(f, 1023, decimated));
+  TEST_ASSERT_EQUAL_UINT16(4092, decimated);
+  TEST_ASSERT_EQUAL(0, f.accumulator);
+  TEST_ASSERT_EQUAL(0, f.accumulated);
+}
+
+void test_median_rejects_up_to_two_outliers() {
+  SoilFilter f = {};
+  TEST_ASSERT_EQUAL_UINT16(100, soilMedian(f, 100));
+  TEST_ASSERT_EQUAL_UINT16(102, soilMedian(f, 102)); // Upper median while the window fills
+  soilMedian(f, 101);
+  soilMedian(f, 99);
+  TEST_ASSERT_EQUAL_UINT16(100, soilMedian(f, 100));
+  TEST_ASSERT_EQUAL_UINT16(101, soilMedian(f, 4000));
+  TEST_ASSERT_EQUAL_UINT16(101, soilMedian(f, 4000)); // Two outliers in a window of five
+  TEST_ASSERT_EQUAL_UINT16(4000, soilMedian(f, 4000)); // Three is a real change
+}
+
+// Whole-sample glitches in the trace never reach the filtered value: while the median window
+// holds a glitch, the output stays between the clean samples in the window
+void test_trace_glitches_are_rejected() {
+  TraceRun run = {};
+  replay(run, CAPACITIVE, false);
+  uint16_t windowsWithGlitches = 0;
+  for (uint16_t i = SOIL_MEDIAN_WINDOW - 1; i < TRACE_SAMPLES; ++i) {
+    uint16_t low = 0xFFFF;
+    uint16_t high = 0;
+    bool glitched = false;
+    for (uint16_t k = i + 1 - SOIL_MEDIAN_WINDOW; k <= i; ++k) {
+      if (isGlitch(k)) {
+        glitched = true;
+      } else {
+        low = run.decimated[k] < low ? run.decimated[k] : low;
+        high = run.decimated[k] > high ? run.decimated[k] : high;
+      }
+    }
+    if (glitched) {
+      windowsWithGlitches++;
+      TEST_ASSERT_GREATER_OR_EQUAL(low, run.filtered[i]);
+      TEST_ASSERT_LESS_OR_EQUAL(high, run.filtered[i]);
+    }
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL(30, windowsWithGlitches);
+}
+
+// Single 0/1023 reads are averaged out by the decimation
+void test_trace_read_spikes_stay_small() {
+  TraceRun run = {};
+  replay(run, CAPACITIVE, false);
+  for (uint16_t i = SOIL_MEDIAN_WINDOW; i < 30; ++i) {
+    TEST_ASSERT_INT_WITHIN(2, 5, run.percent[i]); // Dry soil at raw ~780 is 5 %
+  }
+}
+
+// The percentage dips back under wetOnPercent while wet and dithers around wetOffPercent
+// while drying, but the wet flag switches exactly once each way
+void test_trace_hysteresis_edges() {
+  TraceRun run = {};
+  replay(run, CAPACITIVE, false);
+  uint16_t onCrossings = 0;
+  uint16_t offCrossings = 0;
+  uint16_t wetEdges = 0;
+  uint16_t dryEdges = 0;
+  uint16_t firstWet = 0;
+  for (uint16_t i = 1; i < TRACE_SAMPLES; ++i) {
+    onCrossings += (run.percent[i - 1] >= 60) != (run.percent[i] >= 60);
+    offCrossings += (run.percent[i - 1] >= 50) != (run.percent[i] >= 50);
+    if (!run.wet[i - 1] && run.wet[i]) {
+      wetEdges++;
+      firstWet = i;
+      TEST_ASSERT_GREATER_OR_EQUAL(60, run.percent[i]);
+    }
+    if (run.wet[i - 1] && !run.wet[i]) {
+      dryEdges++;
+      TEST_ASSERT_LESS_THAN(50, run.percent[i]);
+    }
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL(2, onCrossings);
+  TEST_ASSERT_GREATER_OR_EQUAL(3, offCrossings);
+  TEST_ASSERT_EQUAL(1, wetEdges);
+  TEST_ASSERT_EQUAL(1, dryEdges);
+  TEST_ASSERT_FALSE(run.wet[firstWet - 1]);
+  TEST_ASSERT_FALSE(run.wet[TRACE_SAMPLES - 1]);
+}
+
+void test_hysteresis_thresholds_are_inclusive_on_and_exclusive_off() {
+  TEST_ASSERT_FALSE(soilHysteresis(CAPACITIVE, false, 59));
+  TEST_ASSERT_TRUE(soilHysteresis(CAPACITIVE, false, 60));
+  TEST_ASSERT_TRUE(soilHysteresis(CAPACITIVE, true, 50));
+  TEST_ASSERT_FALSE(soilHysteresis(CAPACITIVE, true, 49));
+  TEST_ASSERT_FALSE(soilHysteresis(CAPACITIVE, false, 55)); // Between the thresholds nothing changes
+  TEST_ASSERT_TRUE(soilHysteresis(CAPACITIVE, true, 55));
+}
+
+// A sensor that reads higher when wet (rawWet > rawDry) sees the mirrored trace the same way
+void test_calibration_wet_above_dry() {
+  TraceRun capacitive = {};
+  replay(capacitive, CAPACITIVE, false);
+  TraceRun resistive = {};
+  replay(resistive, RESISTIVE, true);
+  for (uint16_t i = 0; i < TRACE_SAMPLES; ++i) {
+    TEST_ASSERT_INT_WITHIN(1, capacitive.percent[i], resistive.percent[i]);
+    TEST_ASSERT_EQUAL(capacitive.wet[i], resistive.wet[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT8(0, soilPercent(RESISTIVE, 223 << SOIL_DECIMATION_SHIFT));
+  TEST_ASSERT_EQUAL_UINT8(100, soilPercent(RESISTIVE, 623 << SOIL_DECIMATION_SHIFT));
+  TEST_ASSERT_EQUAL_UINT8(50, soilPercent(RESISTIVE, 423 << SOIL_DECIMATION_SHIFT));
+}
+
+void test_calibration_clamps_and_degenerate_points() {
+  TEST_ASSERT_EQUAL_UINT8(0, soilPercent(CAPACITIVE, 1000 << SOIL_DECIMATION_SHIFT));  // Drier than dry
+  TEST_ASSERT_EQUAL_UINT8(100, soilPercent(CAPACITIVE, 100 << SOIL_DECIMATION_SHIFT)); // Wetter than wet
+  TEST_ASSERT_EQUAL_UINT8(0, soilPercent(RESISTIVE, 0));
+  TEST_ASSERT_EQUAL_UINT8(100, soilPercent(RESISTIVE, 4092));
+  SoilSettings uncalibrated = {true, 500, 500, 60, 50, 30};
+  TEST_ASSERT_EQUAL_UINT8(0, soilPercent(uncalibrated, 2000));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_decimation_sums_to_12_bit);
+  RUN_TEST(test_median_rejects_up_to_two_outliers);
+  RUN_TEST(test_trace_glitches_are_rejected);
+  RUN_TEST(test_trace_read_spikes_stay_small);
+  RUN_TEST(test_trace_hysteresis_edges);
+  RUN_TEST(test_hysteresis_thresholds_are_inclusive_on_and_exclusive_off);
+  RUN_TEST(test_calibration_wet_above_dry);
+  RUN_TEST(test_calibration_clamps_and_degenerate_points);
+  return UNITY_END();
+}
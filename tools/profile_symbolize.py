@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Symbolize a /profile dump from the Solenoid Controller against the firmware ELF.
+
+Usage:
+  curl http://192.168.4.1/profile > profile.txt
+  python3 tools/profile_symbolize.py profile.txt .pio/build/d1_mini/firmware.elf
+  python3 tools/profile_symbolize.py profile.txt firmware.elf --folded > profile.folded
+  flamegraph.pl profile.folded > profile.svg
+
+The flat profile lists samples per function. --folded prints "file;function count"
+lines for flamegraph.pl / speedscope (only the sampled PC is known, so the source
+file stands in for the caller).
+"""
+import argparse
+import collections
+import os
+import shutil
+import subprocess
+import sys
+
+ADDR2LINE = "xtensa-lx106-elf-addr2line"
+
+
+def find_addr2line():
+    if shutil.which(ADDR2LINE):
+        return ADDR2LINE
+    # PlatformIO keeps the toolchain out of PATH
+    candidate = os.path.expanduser(
+        "~/.platformio/packages/toolchain-xtensa/bin/" + ADDR2LINE)
+    if os.path.exists(candidate):
+        return candidate
+    sys.exit("error: %s not found (add the PlatformIO toolchain to PATH)" % ADDR2LINE)
+
+
+def read_dump(path):
+    header = ""
+    samples = []
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            if line.startswith("#"):
+                header = line
+                continue
+            pc, count = line.split()
+            samples.append((int(pc, 16), int(count)))
+    return header, samples
+
+
+def symbolize(elf, addresses):
+    out = subprocess.run([find_addr2line(), "-f", "-C", "-e", elf] +
+                         ["0x%08x" % a for a in addresses],
+                         check=True, capture_output=True, text=True).stdout.splitlines()
+    symbols = {}
+    for i, address in enumerate(addresses):
+        function = out[2 * i] if 2 * i < len(out) else "??"
+        location = out[2 * i + 1] if 2 * i + 1 < len(out) else "??:0"
+        source = os.path.basename(location.split(":")[0])
+        symbols[address] = (function, source)
+    return symbols
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dump", help="output of GET /profile")
+    parser.add_argument("elf", help="firmware ELF (.pio/build/d1_mini/firmware.elf)")
+    parser.add_argument("--folded", action="store_true", help="print folded stacks for flame graphs")
+    args = parser.parse_args()
+
+    header, samples = read_dump(args.dump)
+    if not samples:
+        sys.exit("no samples in dump")
+    symbols = symbolize(args.elf, [pc for pc, _ in samples])
+
+    per_function = collections.Counter()
+    for pc, count in samples:
+        function, source = symbols[pc]
+        if function == "??":
+            # Mask ROM (0x4000xxxx) and stripped SDK code have no symbols
+            function = "rom" if pc < 0x40100000 else "0x%08x" % pc
+        per_function[(source, function)] += count
+
+    if args.folded:
+        for (source, function), count in per_function.most_common():
+            print("%s;%s %d" % (source, function, count))
+        return
+
+    total = sum(per_function.values())
+    print(header)
+    print("%8s %7s  %s" % ("samples", "%", "function (source)"))
+    for (source, function), count in per_function.most_common():
+        print("%8d %6.2f%%  %s (%s)" % (count, 100.0 * count / total, function, source))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,146 @@
+// Run the firmware's cycle-and-soak engine (src/pulse_engine.h) on the PC.
+//
+// Build and run:
+//   g++ -std=gnu++17 -O2 -Isrc tools/pulse_sim.cpp -o pulse_sim
+//   ./pulse_sim --zone 30,4,20,0 --zone 20,3,15,-10 --supply 1
+//   ./pulse_sim --zone 60,10,30,0 --loop-ms 15 --jitter-ms 40 --timeline
+//
+// Each --zone is ON minutes, cycles, soak minutes and ramp percent, like the settings of
+// one valve (up to three zones). The engine is compiled from the same header as the
+// firmware, with a stubbed clock and valve layer, and stepped like the valves task: once
+// per loop pass, with a random extra delay per pass to model slow HTTP handlers. It reports
+// how long all zones take compared with running them back-to-back, and how far each pulse
+// ended after its nominal end.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include "pulse_engine.h"
+
+uint64_t simNowMs = 0;
+bool simOpen[PULSE_CHANNELS];
+uint64_t simOpenedMs[PULSE_CHANNELS];
+uint32_t simDurationMs[PULSE_CHANNELS];
+uint64_t simIdealEndMs[PULSE_CHANNELS];
+uint64_t simFinishedMs[PULSE_CHANNELS];
+uint64_t simErrorTotalMs[PULSE_CHANNELS];
+uint32_t simErrorMaxMs[PULSE_CHANNELS];
+uint32_t simPulses[PULSE_CHANNELS];
+bool simTimeline = false;
+
+uint64_t pulseNowMs() { return simNowMs; }
+bool pulseValveIsOpen(uint8_t channel) { return simOpen[channel]; }
+
+void pulseValveOpen(uint8_t channel, uint32_t durationMs) {
+  simOpen[channel] = true;
+  simOpenedMs[channel] = simNowMs;
+  simDurationMs[channel] = durationMs;
+  simIdealEndMs[channel] = pulsePrograms[channel].deadlineMs;
+  if (simTimeline) {
+    const PulseProgram& program = pulsePrograms[channel];
+    printf("%9.1f s  zone %u pulse %u/%u for %.1f min\n", simNowMs / 1000.0, channel + 1, program.cycle + 1,
+           program.cycles, durationMs / 60000.0);
+  }
+}
+
+void pulseValveClose(uint8_t channel) {
+  simOpen[channel] = false;
+  uint32_t errorMs = simNowMs > simIdealEndMs[channel] ? simNowMs - simIdealEndMs[channel] : 0;
+  simErrorTotalMs[channel] += errorMs;
+  simErrorMaxMs[channel] = errorMs > simErrorMaxMs[channel] ? errorMs : simErrorMaxMs[channel];
+  simPulses[channel]++;
+  if (simTimeline) {
+    printf("%9.1f s  zone %u off\n", simNowMs / 1000.0, channel + 1);
+  }
+}
+
+void pulsePhaseChanged(uint8_t channel) {}
+
+void pulseNotify(uint8_t channel, PulseNotice notice) {
+  if (notice == PULSE_NOTICE_DONE) {
+    simFinishedMs[channel] = simNowMs;
+  }
+}
+
+void usage() {
+  fprintf(stderr, "usage: pulse_sim --zone ON,CYCLES,SOAK,RAMP [--zone ...] [--supply N] [--loop-ms N]\n"
+                  "                 [--jitter-ms N] [--seed N] [--timeline]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv) {
+  uint32_t onMinutes[PULSE_CHANNELS];
+  uint8_t zones = 0;
+  unsigned supply = 1;
+  unsigned loopMs = 10;
+  unsigned jitterMs = 5;
+  unsigned seed = 1;
+  for (int i = 1; i < argc; ++i) {
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (strcmp(argv[i], "--timeline") == 0) {
+      simTimeline = true;
+      continue;
+    }
+    if (!value) {
+      usage();
+    }
+    if (strcmp(argv[i], "--zone") == 0) {
+      int on, cycles, soak, ramp;
+      if (zones == PULSE_CHANNELS || sscanf(value, "%d,%d,%d,%d", &on, &cycles, &soak, &ramp) != 4) {
+        usage();
+      }
+      onMinutes[zones] = on;
+      pulseSettings[zones] = {(uint8_t)cycles, (uint8_t)soak, (int8_t)ramp};
+      zones++;
+    } else if (strcmp(argv[i], "--supply") == 0) {
+      supply = atoi(value);
+    } else if (strcmp(argv[i], "--loop-ms") == 0) {
+      loopMs = atoi(value);
+    } else if (strcmp(argv[i], "--jitter-ms") == 0) {
+      jitterMs = atoi(value);
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      seed = atoi(value);
+    } else {
+      usage();
+    }
+    ++i;
+  }
+  if (zones == 0 || supply == 0) {
+    usage();
+  }
+  pulseSupplyValves = supply;
+
+  std::mt19937 random(seed);
+  std::exponential_distribution<double> jitter(jitterMs ? 1.0 / jitterMs : 1.0);
+  for (uint8_t i = 0; i < zones; ++i) {
+    pulseStart(i, onMinutes[i] * 60000UL, 0);
+  }
+  for (bool running = true; running;) {
+    simNowMs += loopMs + (jitterMs ? (uint64_t)jitter(random) : 0);
+    // Valve timeouts, as in taskValves(), then the engine
+    for (uint8_t i = 0; i < zones; ++i) {
+      if (simOpen[i] && simNowMs - simOpenedMs[i] >= simDurationMs[i]) {
+        pulseValveClose(i);
+      }
+    }
+    pulseUpdate();
+    running = false;
+    for (uint8_t i = 0; i < zones; ++i) {
+      running |= pulsePrograms[i].phase != PULSE_IDLE;
+    }
+  }
+
+  uint64_t makespanMs = 0;
+  uint64_t backToBackMs = 0;
+  for (uint8_t i = 0; i < zones; ++i) {
+    const PulseProgram& program = pulsePrograms[i];
+    backToBackMs += onMinutes[i] * 60000ULL + (uint64_t)program.soakMs * (program.cycles - 1);
+    makespanMs = simFinishedMs[i] > makespanMs ? simFinishedMs[i] : makespanMs;
+    printf("zone %u: %u pulses, done at %.1f min, waited %.1f s, pulse end error avg %.1f ms max %u ms\n", i + 1,
+           program.cycles, simFinishedMs[i] / 60000.0, program.waitedMs / 1000.0,
+           (double)simErrorTotalMs[i] / simPulses[i], simErrorMaxMs[i]);
+  }
+  printf("interleaved: %.1f min, back-to-back: %.1f min, %.1f min saved\n", makespanMs / 60000.0,
+         backToBackMs / 60000.0, ((double)backToBackMs - makespanMs) / 60000.0);
+  return 0;
+}
@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""Create, inspect, diff and transfer Solenoid Controller configuration snapshots.
+
+Usage:
+  python3 tools/snapshot.py pull 192.168.4.1 -o base.wcs
+  python3 tools/snapshot.py show base.wcs
+  python3 tools/snapshot.py make -o zone.wcs --from base.wcs solenoid1OnTime=15 solenoid1PulseCycles=3
+  python3 tools/snapshot.py diff base.wcs zone.wcs
+  python3 tools/snapshot.py push zone.wcs 192.168.4.1 [--calibration]
+
+The format matches handleGetSnapshot() in main.cpp: "WCS1", uint16 version, uint16
+payload length, records of (uint8 id, uint8 size, value), then the zlib CRC-32.
+Calibration fields (clock drift, soil sensor raw points) are only applied by the device
+when pushed with --calibration.
+"""
+import argparse
+import struct
+import sys
+import urllib.request
+import uuid
+import zlib
+
+MAGIC = b"WCS1"
+VERSION = 1
+
+# id: (name, struct format); ids and sizes must match SNAPSHOT_FIELDS in main.cpp
+FIELDS = {
+    1: ("solenoid1OnTime", "<I"),
+    2: ("solenoid1SchedHour", "<B"),
+    3: ("solenoid1SchedMin", "<B"),
+    4: ("solenoid1SchedEnabled", "<?"),
+    5: ("solenoid1PulseCycles", "<B"),
+    6: ("solenoid1SoakMin", "<B"),
+    7: ("solenoid1RampPercent", "<b"),
+    11: ("solenoid2OnTime", "<I"),
+    12: ("solenoid2SchedHour", "<B"),
+    13: ("solenoid2SchedMin", "<B"),
+    14: ("solenoid2SchedEnabled", "<?"),
+    15: ("solenoid2PulseCycles", "<B"),
+    16: ("solenoid2SoakMin", "<B"),
+    17: ("solenoid2RampPercent", "<b"),
+    21: ("solenoid3OnTime", "<I"),
+    22: ("solenoid3SchedHour", "<B"),
+    23: ("solenoid3SchedMin", "<B"),
+    24: ("solenoid3SchedEnabled", "<?"),
+    25: ("solenoid3PulseCycles", "<B"),
+    26: ("solenoid3SoakMin", "<B"),
+    27: ("solenoid3RampPercent", "<b"),
+    40: ("tzOffsetMinutes", "<h"),
+    41: ("clockDriftPpb", "<i"),
+    50: ("soilEnabled", "<?"),
+    51: ("soilRawDry", "<H"),
+    52: ("soilRawWet", "<H"),
+    53: ("soilWetOnPercent", "<B"),
+    54: ("soilWetOffPercent", "<B"),
+    55: ("soilDryPercent", "<B"),
+}
+IDS = {name: field_id for field_id, (name, _) in FIELDS.items()}
+
+
+def decode(data):
+    """Return {name: value}; unknown ids are kept as 'field<id>' hex strings."""
+    if len(data) < 12 or data[:4] != MAGIC:
+        sys.exit("error: not a snapshot")
+    version, payload_length = struct.unpack_from("<HH", data, 4)
+    if version != VERSION:
+        sys.exit("error: unsupported snapshot version %d" % version)
+    if 8 + payload_length + 4 != len(data):
+        sys.exit("error: snapshot length mismatch")
+    (crc,) = struct.unpack_from("<I", data, len(data) - 4)
+    if crc != zlib.crc32(data[:-4]):
+        sys.exit("error: snapshot CRC mismatch")
+    values = {}
+    offset = 8
+    end = 8 + payload_length
+    while offset < end:
+        field_id, size = data[offset], data[offset + 1]
+        raw = data[offset + 2:offset + 2 + size]
+        if field_id in FIELDS:
+            name, fmt = FIELDS[field_id]
+            values[name] = struct.unpack(fmt, raw)[0]
+        else:
+            values["field%d" % field_id] = raw.hex()
+        offset += 2 + size
+    return values
+
+
+def encode(values):
+    payload = b""
+    for field_id, (name, fmt) in sorted(FIELDS.items()):
+        if name in values:
+            raw = struct.pack(fmt, values[name])
+            payload += bytes([field_id, len(raw)]) + raw
+    data = MAGIC + struct.pack("<HH", VERSION, len(payload)) + payload
+    return data + struct.pack("<I", zlib.crc32(data))
+
+
+def parse_assignment(text):
+    name, _, value = text.partition("=")
+    if name not in IDS:
+        sys.exit("error: unknown field %s" % name)
+    fmt = FIELDS[IDS[name]][1]
+    if fmt == "<?":
+        return name, value.lower() in ("1", "true", "on", "yes")
+    return name, int(value, 0)
+
+
+def read(path):
+    with open(path, "rb") as f:
+        return decode(f.read())
+
+
+def cmd_show(args):
+    for name, value in read(args.file).items():
+        print("%-24s %s" % (name, value))
+
+
+def cmd_diff(args):
+    a, b = read(args.a), read(args.b)
+    differences = 0
+    for name in list(a) + [n for n in b if n not in a]:
+        if a.get(name) != b.get(name):
+            print("%-24s %s -> %s" % (name, a.get(name, "-"), b.get(name, "-")))
+            differences += 1
+    return 1 if differences else 0
+
+
+def cmd_make(args):
+    values = read(args.base) if args.base else {}
+    values.update(parse_assignment(text) for text in args.set)
+    with open(args.output, "wb") as f:
+        f.write(encode({k: v for k, v in values.items() if k in IDS}))
+
+
+def cmd_pull(args):
+    with urllib.request.urlopen("http://%s/snapshot" % args.host, timeout=10) as response:
+        data = response.read()
+    decode(data)  # Validate before writing
+    with open(args.output, "wb") as f:
+        f.write(data)
+
+
+def cmd_push(args):
+    with open(args.file, "rb") as f:
+        data = f.read()
+    decode(data)
+    boundary = uuid.uuid4().hex
+    body = (("--%s\r\nContent-Disposition: form-data; name=\"snapshot\"; filename=\"snapshot.wcs\"\r\n"
+             "Content-Type: application/octet-stream\r\n\r\n" % boundary).encode()
+            + data + ("\r\n--%s--\r\n" % boundary).encode())
+    status = 0
+    for host in args.hosts:
+        url = "http://%s/snapshot%s" % (host, "?calibration=1" if args.calibration else "")
+        request = urllib.request.Request(url, data=body, method="POST",
+                                         headers={"Content-Type": "multipart/form-data; boundary=" + boundary})
+        try:
+            with urllib.request.urlopen(request, timeout=10) as response:
+                print("%s: %s" % (host, response.read().decode()))
+        except Exception as error:  # Keep provisioning the remaining units
+            print("%s: %s" % (host, error))
+            status = 1
+    return status
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+    p = commands.add_parser("show", help="print the fields of a snapshot")
+    p.add_argument("file")
+    p.set_defaults(run=cmd_show)
+    p = commands.add_parser("diff", help="print fields that differ; exit status 1 if any")
+    p.add_argument("a")
+    p.add_argument("b")
+    p.set_defaults(run=cmd_diff)
+    p = commands.add_parser("make", help="write a snapshot from a base and name=value pairs")
+    p.add_argument("-o", "--output", required=True)
+    p.add_argument("--from", dest="base")
+    p.add_argument("set", nargs="*")
+    p.set_defaults(run=cmd_make)
+    p = commands.add_parser("pull", help="download a unit's snapshot")
+    p.add_argument("host")
+    p.add_argument("-o", "--output", required=True)
+    p.set_defaults(run=cmd_pull)
+    p = commands.add_parser("push", help="apply a snapshot to one or more units")
+    p.add_argument("file")
+    p.add_argument("hosts", nargs="+")
+    p.add_argument("--calibration", action="store_true", help="also apply calibration fields")
+    p.set_defaults(run=cmd_push)
+    args = parser.parse_args()
+    sys.exit(args.run(args) or 0)
+
+
+if __name__ == "__main__":
+    main()
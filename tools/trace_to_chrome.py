@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Convert a /trace dump from the Solenoid Controller to Chrome trace JSON.
+
+Usage:
+  curl http://192.168.4.1/trace > trace.bin
+  python3 tools/trace_to_chrome.py trace.bin > trace.json
+
+Open trace.json in https://ui.perfetto.dev or chrome://tracing. Records written from
+interrupts appear on the "isr" track, everything else on the "loop" track.
+"""
+import argparse
+import json
+import struct
+import sys
+
+LOOP_TID = 1
+ISR_TID = 2
+FROM_ISR = 0x80
+
+
+def parse(data):
+    if data[:4] != b"TRC1":
+        sys.exit("error: not a trace dump (bad magic)")
+    version, name_count = struct.unpack_from("<HH", data, 4)
+    if version != 1:
+        sys.exit("error: unsupported trace version %d" % version)
+    offset = 8
+    names = []
+    for _ in range(name_count):
+        end = data.index(b"\0", offset)
+        names.append(data[offset:end].decode())
+        offset = end + 1
+    (count,) = struct.unpack_from("<I", data, offset)
+    offset += 4
+    records = [struct.unpack_from("<IBBH", data, offset + 8 * i) for i in range(count)]
+    return names, records
+
+
+def convert(names, records):
+    events = [
+        {"ph": "M", "name": "process_name", "pid": 1, "args": {"name": "Solenoid Controller"}},
+        {"ph": "M", "name": "thread_name", "pid": 1, "tid": LOOP_TID, "args": {"name": "loop"}},
+        {"ph": "M", "name": "thread_name", "pid": 1, "tid": ISR_TID, "args": {"name": "isr"}},
+    ]
+    # micros() wraps every ~71.6 minutes; unwrap assuming records are in order
+    base = 0
+    previous = None
+    for time_us, phase, trace_id, arg in records:
+        if previous is not None and time_us < previous:
+            base += 1 << 32
+        previous = time_us
+        name = names[trace_id] if trace_id < len(names) else "id%d" % trace_id
+        event = {
+            "name": name,
+            "ph": chr(phase & ~FROM_ISR),
+            "ts": base + time_us,
+            "pid": 1,
+            "tid": ISR_TID if phase & FROM_ISR else LOOP_TID,
+            "args": {"arg": arg},
+        }
+        if event["ph"] == "i":
+            event["s"] = "t"
+        events.append(event)
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dump", help="output of GET /trace")
+    args = parser.parse_args()
+    with open(args.dump, "rb") as f:
+        names, records = parse(f.read())
+    json.dump(convert(names, records), sys.stdout, indent=1)
+    print()
+
+
+if __name__ == "__main__":
+    main()